@@ -11,8 +11,18 @@ extern "C" {
 #define OUT
 
 #define CTI_SUCCESS 0
+#define CTI_FAILURE -1
+
+#define CTI_TYPE_REFCOUNTED 1
+
+#define CTI_STATS_BUCKETS 32
 
 typedef void* func_handle;
+typedef void* retvalue_handle;
+typedef void* completionqueue_handle;
+typedef void* stream_handle;
+typedef void* mappedfile_handle;
+typedef void* object_handle;
 // typedef void* packedvalue_handle;
 typedef union {
   int64_t v_int64;
@@ -21,13 +31,164 @@ typedef union {
   const char* v_str;
 } packedvalue_handle;
 
+// Element type of a kTensor, code is 0 for int, 1 for uint and 2 for float.
+typedef struct {
+  uint8_t code;
+  uint8_t bits;
+  uint16_t lanes;
+} packeddtype_handle;
+
+// A kTensor value is passed as v_voidp pointing to this struct. strides count elements,
+// NULL means compact row-major. Nothing is copied, data must outlive the call.
+typedef struct {
+  void* data;
+  packeddtype_handle dtype;
+  int32_t ndim;
+  const int64_t* shape;
+  const int64_t* strides;
+} packedtensor_handle;
+
+// A kRagged value is passed as v_voidp pointing to this struct. Row i holds
+// values[offsets[i], offsets[i+1]) of type_code, offsets has num_rows + 1 entries starting at 0.
+typedef struct {
+  packedvalue_handle* values;
+  const int64_t* offsets;
+  size_t num_rows;
+  unsigned type_code;
+} packedragged_handle;
+
+// A kBytes value is passed as v_voidp pointing to this struct, data may hold NULs and is not terminated.
+typedef struct {
+  const char* data;
+  size_t size;
+} packedbytes_handle;
+
+// Body of a function made by CTIPackedFuncCreate. The result stays owned by the callback and is copied
+// before it returns to native code, return CTI_FAILURE to report an error.
+typedef int (*packedcallback_handle)(void* resource, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
+    OUT unsigned* ret_type, OUT packedvalue_handle* ret_val);
+typedef void (*packedfinalizer_handle)(void* resource);
+
+// Counters of a registered function. histogram[i] counts calls taking [2^i, 2^(i+1)) ns, the last
+// bucket everything longer. ret_bytes sums the data owned by results (strings, bytes, vectors, tensors).
+typedef struct {
+  uint64_t calls;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t ret_bytes;
+  uint64_t histogram[CTI_STATS_BUCKETS];
+} funcstats_handle;
+
 CTI_EXPORT int CTIRegistryListNames(const char* tag, OUT size_t* ret_size, OUT const char*** ret_names);
 
+CTI_EXPORT int CTIRegistryFreeze(const char* tag);
+
 CTI_EXPORT int CTIRegistryGet(const char* tag, const char* name, OUT func_handle* ret_handle);
 
+// Start or stop counting the calls of every registered function, counting is off at first.
+// Returns CTI_FAILURE if the library was built without CTI_ENABLE_STATS.
+CTI_EXPORT int CTIRegistryStatsEnable(int enable);
+
+// Counters of the function registered as name, nested calls from native code included.
+// Returns CTI_FAILURE if there is no such function or the library was built without CTI_ENABLE_STATS.
+CTI_EXPORT int CTIRegistryStats(const char* tag, const char* name, OUT funcstats_handle* ret_stats);
+
+// Clears the counters of name, or of every function if name is NULL.
+CTI_EXPORT int CTIRegistryStatsReset(const char* tag, const char* name);
+
+// The result stays valid until the next CTIPackedFuncCall or CTIPackedFuncCallBatch on the same thread.
 CTI_EXPORT int CTIPackedFuncCall(const void* handle, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
     OUT unsigned* ret_type, OUT packedvalue_handle* ret_val);
 
+// Same as CTIPackedFuncCall, but the result is owned by the caller and stays valid until CTIRetValueRelease.
+CTI_EXPORT int CTIPackedFuncCallOwned(const void* handle, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
+    OUT retvalue_handle* ret_handle, OUT unsigned* ret_type, OUT packedvalue_handle* ret_val);
+
+CTI_EXPORT int CTIRetValueRelease(retvalue_handle handle);
+
+CTI_EXPORT int CTICompletionQueueCreate(OUT completionqueue_handle* ret_queue);
+
+// Waits for calls still running on the queue, results not taken out are released.
+CTI_EXPORT int CTICompletionQueueFree(completionqueue_handle queue);
+
+// Run the call on the library's worker pool, the result is delivered to queue under ret_ticket.
+// Data referenced by values (strings, vectors, ...) must stay alive until the call completes.
+CTI_EXPORT int CTIPackedFuncCallAsync(const void* handle, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
+    completionqueue_handle queue, OUT uint64_t* ret_ticket);
+
+// timeout_ms < 0 waits forever and 0 only polls; ret_ready is 0 if no call completed in time,
+// or right away if no call is outstanding.
+// A taken result is owned by the caller, see CTIRetValueRelease.
+CTI_EXPORT int CTICompletionQueueWait(completionqueue_handle queue, int64_t timeout_ms, OUT int* ret_ready, OUT uint64_t* ret_ticket,
+    OUT retvalue_handle* ret_handle, OUT unsigned* ret_type, OUT packedvalue_handle* ret_val);
+
+// Thread count and counters of the scheduler behind the parallel_for/parallel_map PackedFuncs.
+CTI_EXPORT int CTIParallelGetStats(OUT size_t* ret_num_threads, OUT uint64_t* ret_calls, OUT uint64_t* ret_tasks, OUT uint64_t* ret_steals);
+
+// Pull the next chunk of a kStream value, ret_has_next is 0 once it is exhausted.
+// The chunk stays valid until the next call on the same stream.
+CTI_EXPORT int CTIStreamNext(stream_handle stream, OUT int* ret_has_next, OUT unsigned* ret_type, OUT packedvalue_handle* ret_val);
+
+// A returned stream belongs to the caller and must be closed.
+CTI_EXPORT int CTIStreamClose(stream_handle stream);
+
+// Call handle num_calls times, type_codes and values hold num_calls rows of num_args each.
+// Results stay valid until the next CTIPackedFuncCall or CTIPackedFuncCallBatch on the same thread.
+CTI_EXPORT int CTIPackedFuncCallBatch(const void* handle, size_t num_calls, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
+    OUT unsigned* ret_types, OUT packedvalue_handle* ret_vals);
+
+// Wrap callback as a PackedFunc, pass the handle as a kFunc value. It may be called from any thread,
+// including the worker pool. finalizer, which may be NULL, gets resource once the function and every
+// copy native code kept are dropped.
+CTI_EXPORT int CTIPackedFuncCreate(packedcallback_handle callback, void* resource, packedfinalizer_handle finalizer, OUT func_handle* ret_handle);
+
+// Drops a function made by CTIPackedFuncCreate.
+CTI_EXPORT int CTIPackedFuncFree(func_handle handle);
+
+// Arena of the calling thread, which holds the results of CTIPackedFuncCall and CTIPackedFuncCallBatch
+// and is reset by the next call of either. ret_used counts bytes handed out since that reset.
+CTI_EXPORT int CTIArenaGetStats(OUT size_t* ret_used, OUT size_t* ret_reserved, OUT size_t* ret_high_water,
+    OUT uint64_t* ret_resets, OUT uint64_t* ret_allocations, OUT uint64_t* ret_oversized);
+
+// Size of arena chunks allocated from now on by every thread, larger allocations get a chunk of their own.
+CTI_EXPORT int CTIArenaSetChunkSize(size_t chunk_size);
+
+// Record a span for every PackedFunc call from now on, nested ones included, keeping up to
+// events_per_thread spans per thread (0 picks a default). Drops the spans of an earlier session.
+// Returns CTI_FAILURE if the library was built without CTI_ENABLE_TRACE.
+CTI_EXPORT int CTITraceStart(size_t events_per_thread);
+
+CTI_EXPORT int CTITraceStop();
+
+// Write the spans of the last session to path as Chrome trace-event JSON, viewable in Perfetto.
+// ret_dropped counts spans left out because a thread's buffer was full.
+CTI_EXPORT int CTITraceDump(const char* path, OUT uint64_t* ret_dropped);
+
+// Map the file at path read-only as a 1-d tensor of dtype, returns CTI_FAILURE if it could not be mapped
+// or its size is not a multiple of dtype. Pass the handle as a kMappedFile value, functions taking a
+// kTensor accept it too. POSIX only.
+CTI_EXPORT int CTIMappedFileOpen(const char* path, packeddtype_handle dtype, OUT mappedfile_handle* ret_handle);
+
+// Unmaps the file, the handle must not be in use by a running call.
+CTI_EXPORT int CTIMappedFileRelease(mappedfile_handle handle);
+
+// Take or drop a reference to an ext value whose type derives ctypes::Object. A returned object is
+// only held by the result, so retain it to keep it past the next call.
+CTI_EXPORT int CTIObjectRetain(object_handle handle);
+CTI_EXPORT int CTIObjectRelease(object_handle handle);
+
+// Lists the registered types, ordered by name. The arrays stay valid until the next call on the thread.
+CTI_EXPORT int CTITypeList(OUT size_t* ret_size, OUT const unsigned** ret_codes, OUT const char*** ret_names);
+
+// Name, size of the value v_voidp points to (0 if stored inline) and CTI_TYPE_* flags of type_code,
+// returns CTI_FAILURE if nothing is registered for it.
+CTI_EXPORT int CTITypeGetInfo(unsigned type_code, OUT const char** ret_name, OUT size_t* ret_size, OUT unsigned* ret_flags);
+
+// Copy (or retain, for refcounted types) and free ext values through the hooks their type registered,
+// return CTI_FAILURE if it has none.
+CTI_EXPORT int CTITypeCopy(unsigned type_code, void* value, OUT void** ret_value);
+CTI_EXPORT int CTITypeFree(unsigned type_code, void* value);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "base.h"
+
+namespace ctypes {
+
+// Per-thread bump allocator for the temporaries of one top-level call. Memory is taken from
+// fixed-size chunks by bumping an offset and given back all at once when the outermost Scope
+// on the thread starts, so objects placed here are destroyed in place and never freed one by one.
+struct Arena {
+  static constexpr size_t kDefaultChunkSize = 64 << 10;
+
+  struct Stats {
+    // bytes handed out since the last reset, including padding
+    size_t used;
+    // bytes held by the chunks
+    size_t reserved;
+    // largest used seen at a reset
+    size_t high_water;
+    // counted since the thread started
+    uint64_t resets;
+    uint64_t allocations;
+    // allocations larger than a chunk, which got a chunk of their own
+    uint64_t oversized;
+  };
+
+  // Makes the thread's arena current. The outermost scope on a thread resets the arena first,
+  // so nothing allocated in a previous scope may still be alive when it starts.
+  struct Scope {
+    Scope() : prev(current_) {
+      if (depth_++ == 0) {
+        Local()->reset();
+      }
+      current_ = Local();
+    }
+    ~Scope() {
+      depth_--;
+      current_ = prev;
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    Arena* prev;
+  };
+
+  // Allocates from the heap again inside a scope, for results that outlive it.
+  struct Suspend {
+    Suspend() : prev(current_) {
+      current_ = nullptr;
+    }
+    ~Suspend() {
+      current_ = prev;
+    }
+    Suspend(const Suspend&) = delete;
+    Suspend& operator=(const Suspend&) = delete;
+
+  private:
+    Arena* prev;
+  };
+
+  // the calling thread's arena if a scope is active and not suspended
+  static Arena* Current() {
+    return current_;
+  }
+
+  // number of scopes active on the calling thread
+  static size_t Depth() {
+    return depth_;
+  }
+
+  static Arena* Local() {
+    static thread_local Arena arena;
+    return &arena;
+  }
+
+  // size of chunks allocated from now on, by every thread
+  static void SetChunkSize(size_t size) {
+    chunk_size_.store(std::max<size_t>(size, 64), std::memory_order_relaxed);
+  }
+
+  static size_t ChunkSize() {
+    return chunk_size_.load(std::memory_order_relaxed);
+  }
+
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void* allocate(size_t size, size_t align) {
+    stats_.allocations++;
+    if (index_ < chunks_.size()) {
+      // chunks are only max_align_t aligned, so align the address rather than the offset
+      unsigned char* data = chunks_[index_].data.get();
+      size_t begin = align_up(data + offset_, align) - data;
+      if (begin + size <= chunks_[index_].size) {
+        stats_.used += begin + size - offset_;
+        offset_ = begin + size;
+        return data + begin;
+      }
+    }
+    return allocate_slow(size, align);
+  }
+
+  template <typename T, typename... Args>
+  T* create(Args&&... args) {
+    return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  void reset() {
+    stats_.high_water = std::max(stats_.high_water, stats_.used);
+    stats_.used = 0;
+    stats_.resets++;
+    for (auto& i : oversized_) {
+      stats_.reserved -= i.size;
+    }
+    oversized_.clear();
+    index_ = 0;
+    offset_ = 0;
+  }
+
+  Stats stats() const {
+    Stats r = stats_;
+    r.high_water = std::max(r.high_water, r.used);
+    return r;
+  }
+
+private:
+  struct Chunk {
+    std::unique_ptr<unsigned char[]> data;
+    size_t size;
+  };
+
+  void* allocate_slow(size_t size, size_t align) {
+    // operator new[] aligns to max_align_t, larger alignments take some slack
+    const size_t padded = size + (align > alignof(std::max_align_t) ? align : 0);
+    if (padded > ChunkSize()) {
+      stats_.oversized++;
+      stats_.used += padded;
+      stats_.reserved += padded;
+      oversized_.push_back(Chunk{std::make_unique<unsigned char[]>(padded), padded});
+      return align_up(oversized_.back().data.get(), align);
+    }
+    // chunks made before a SetChunkSize may be too small, skip them
+    for (index_++; index_ < chunks_.size() && chunks_[index_].size < padded; index_++) { }
+    if (index_ >= chunks_.size()) {
+      const size_t chunk_size = ChunkSize();
+      chunks_.push_back(Chunk{std::make_unique<unsigned char[]>(chunk_size), chunk_size});
+      stats_.reserved += chunk_size;
+      index_ = chunks_.size() - 1;
+    }
+    unsigned char* begin = align_up(chunks_[index_].data.get(), align);
+    offset_ = begin - chunks_[index_].data.get() + size;
+    stats_.used += offset_;
+    return begin;
+  }
+
+  static unsigned char* align_up(unsigned char* p, size_t align) {
+    return reinterpret_cast<unsigned char*>((reinterpret_cast<uintptr_t>(p) + align - 1) & ~(uintptr_t(align) - 1));
+  }
+
+  std::vector<Chunk> chunks_;
+  std::vector<Chunk> oversized_;
+  size_t index_ = 0;
+  size_t offset_ = 0;
+  Stats stats_{};
+
+  static inline thread_local Arena* current_ = nullptr;
+  static inline thread_local size_t depth_ = 0;
+  static inline std::atomic<size_t> chunk_size_{kDefaultChunkSize};
+};
+
+// Standard allocator taking memory from the arena current when it was made, or the heap.
+template <typename T>
+struct ArenaAllocator {
+  using value_type = T;
+
+  ArenaAllocator() noexcept : arena(Arena::Current()) { }
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept : arena(other.arena) { }
+
+  T* allocate(size_t n) {
+    if (arena != nullptr) {
+      // aligned like operator new, so byte buffers may hold any element type
+      return static_cast<T*>(arena->allocate(n * sizeof(T), std::max(alignof(T), alignof(std::max_align_t))));
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, size_t) noexcept {
+    if (arena == nullptr) {
+      ::operator delete(p);
+    }
+  }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other) const noexcept {
+    return arena == other.arena;
+  }
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other) const noexcept {
+    return arena != other.arena;
+  }
+
+  Arena* arena;
+};
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include "packedfunc.h"
+
+namespace ctypes {
+
+// Fixed set of workers running tasks in submission order.
+struct ThreadPool {
+  static ThreadPool* Global();
+
+  explicit ThreadPool(size_t num_threads);
+  ~ThreadPool();
+
+  void submit(std::function<void()> task);
+
+  size_t num_threads() const {
+    return workers.size();
+  }
+
+private:
+  void run();
+
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stopped = false;
+};
+
+// Results of asynchronous calls, each is owned by the caller once taken out of the queue.
+struct CompletionQueue {
+  struct Completion {
+    uint64_t ticket;
+    PackedFunc::RetValue* rv;
+  };
+
+  ~CompletionQueue();
+
+  // The values are copied, but whatever they point to must stay alive until the call completes.
+  uint64_t call_async(const PackedFunc* func, size_t num_args, const PackedType* type_codes, const PackedValue* values);
+
+  // timeout_ms < 0 waits forever, 0 only polls. Returns false at once if no call is outstanding.
+  bool wait(int64_t timeout_ms, Completion* completion);
+
+private:
+  void push(Completion completion);
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<Completion> done;
+  uint64_t next_ticket = 0;
+  size_t pending = 0;
+};
+
+}
@@ -5,6 +5,10 @@
 #include <vector>
 #include <mutex>
 #include <map>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <string_view>
 #include <cstring>
 
 class log_stream {
@@ -35,6 +39,15 @@ public:
 #define CHECK_EQ(p, q) (CHECK_(#p " == " #q, (p) == (q)) << "get " << (p) << " expect " << (q) << " ")
 #define CHECK_LE(p, q) (CHECK_(#p " <= " #q, (p) <= (q)) << "get " << (p) << " expect " << (q) << " ")
 
+// loop has no cross-iteration dependence, let the compiler vectorize it
+#if defined(__clang__)
+#define CTI_PRAGMA_SIMD _Pragma("clang loop vectorize(enable) interleave(enable)")
+#elif defined(__GNUC__)
+#define CTI_PRAGMA_SIMD _Pragma("GCC ivdep")
+#else
+#define CTI_PRAGMA_SIMD
+#endif
+
 #define FATAL() fatal(__FILE__, __LINE__)
 inline const char* filename_trim(const char* file) {
   const char* const i = strrchr(file, '/');
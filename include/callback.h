@@ -0,0 +1,22 @@
+#pragma once
+
+#include "packedfunc.h"
+
+namespace ctypes {
+
+// PackedFunc whose body is a C function, so hosts can hand their own callables to native code.
+// The result written by callback is owned by the host, it is copied into the call's RetValue
+// before callback could be entered again on the same thread.
+struct PackedCallback {
+  using Callback = int (*)(void* resource, size_t num_args, const PackedType* type_codes, const PackedValue* values,
+      PackedType* ret_type, PackedValue* ret_val);
+  using Finalizer = void (*)(void* resource);
+
+  // finalizer, if any, runs once the last copy of the function is dropped
+  static PackedFunc Make(Callback callback, void* resource, Finalizer finalizer);
+
+  // copies a value the caller keeps owning into rv, returns false for types that could not be copied
+  static bool CopyResult(PackedType type_code, PackedValue value, PackedFunc::RetValue* rv);
+};
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "packedfunc.h"
+
+namespace ctypes {
+
+// Read-only mapping of a whole file, viewed as a 1-d tensor of dtype. Passed as kMappedFile,
+// which functions taking a PackedTensor accept as well. POSIX only.
+struct MappedFile {
+  // first member, so a MappedFile* is also a PackedTensor*
+  PackedTensor content{};
+
+  // nullptr if the file could not be opened or mapped, or its size is not a multiple of dtype
+  static MappedFile* Open(const std::string& path, PackedDType dtype);
+
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  size_t bytes() const {
+    return bytes_;
+  }
+
+  // kept public, mixed access would make the struct non standard layout
+  int64_t shape_[1] = {0};
+  void* addr_ = nullptr;
+  size_t bytes_ = 0;
+
+private:
+  MappedFile() = default;
+};
+
+static_assert(std::is_standard_layout<MappedFile>::value);
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+#include "base.h"
+#include "slab.h"
+
+namespace ctypes {
+
+template <typename T>
+struct ObjectRef;
+
+template <typename T, typename... Args>
+ObjectRef<T> make_object(Args&&... args);
+
+// Intrusively refcounted base for extension types, so a value can be shared by calls and hosts
+// instead of copied. Objects made by make_object live in a Slab of their type and go back to it
+// when the last reference is dropped, anything else is never freed by the count.
+struct Object {
+  void IncRef() {
+    ref_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void DecRef() {
+    if (ref_count_.fetch_sub(1, std::memory_order_acq_rel) == 1 && deleter_ != nullptr) {
+      deleter_(this);
+    }
+  }
+
+  uint32_t use_count() const {
+    return ref_count_.load(std::memory_order_relaxed);
+  }
+
+protected:
+  Object() = default;
+  Object(const Object&) : Object() { }
+  Object& operator=(const Object&) {
+    return *this;
+  }
+
+private:
+  std::atomic<uint32_t> ref_count_{0};
+  void (*deleter_)(Object*) = nullptr;
+
+  template <typename T, typename... Args>
+  friend ObjectRef<T> make_object(Args&&... args);
+};
+
+// Holds one reference to a T derived from Object.
+template <typename T>
+struct ObjectRef {
+  ObjectRef() = default;
+  explicit ObjectRef(T* p) : p_(p) {
+    if (p_ != nullptr) {
+      p_->IncRef();
+    }
+  }
+  ObjectRef(const ObjectRef& other) : ObjectRef(other.p_) { }
+  ObjectRef(ObjectRef&& other) noexcept : p_(std::exchange(other.p_, nullptr)) { }
+  ObjectRef& operator=(ObjectRef other) noexcept {
+    std::swap(p_, other.p_);
+    return *this;
+  }
+  ~ObjectRef() {
+    if (p_ != nullptr) {
+      p_->DecRef();
+    }
+  }
+
+  // takes over a reference the caller already holds
+  static ObjectRef Adopt(T* p) {
+    ObjectRef r;
+    r.p_ = p;
+    return r;
+  }
+
+  // gives the reference up without dropping it
+  T* release() {
+    return std::exchange(p_, nullptr);
+  }
+
+  T* get() const { return p_; }
+  T* operator->() const { return p_; }
+  T& operator*() const { return *p_; }
+  explicit operator bool() const { return p_ != nullptr; }
+
+private:
+  T* p_ = nullptr;
+};
+
+template <typename T, typename... Args>
+ObjectRef<T> make_object(Args&&... args) {
+  static_assert(std::is_base_of<Object, T>::value);
+  T* p = Slab<T>::New(std::forward<Args>(args)...);
+  // handles cross the C API as T*, which should be the Object* as well
+  CHECK_EQ(static_cast<void*>(static_cast<Object*>(p)), static_cast<void*>(p));
+  p->deleter_ = [](Object* o) { Slab<T>::Delete(static_cast<T*>(o)); };
+  return ObjectRef<T>(p);
+}
+
+}
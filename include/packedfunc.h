@@ -3,12 +3,25 @@
 #include <functional>
 #include <utility>
 #include <memory>
+#include <array>
+#include <deque>
 #include "registry.h"
+#include "slab.h"
+#include "arena.h"
+#include "object.h"
+#include "stats.h"
+#include "trace.h"
 
 namespace ctypes {
 
 struct PackedFunc;
 struct PackedVector;
+struct PackedStream;
+struct PackedTensor;
+struct PackedRagged;
+struct MappedFile;
+template <typename T>
+struct PackedVectorView;
 
 using PackedType = unsigned;
 
@@ -21,6 +34,11 @@ enum PackedType_ {
   kStr = 4,
   kFunc = 5,
   kVector = 6,
+  kStream = 7,
+  kTensor = 8,
+  kRagged = 9,
+  kBytes = 10,
+  kMappedFile = 11,
 };
 
 enum PackedExtType_ {
@@ -53,6 +71,8 @@ template <> struct TypeCode<const char*> : _TypeCode<kStr> { };
 template <> struct TypeCode<std::string> : _TypeCode<kUnknown, kStr> { };
 template <> struct TypeCode<PackedFunc> : _TypeCode<kFunc, kFunc> { };
 template <typename T> struct TypeCode<std::vector<T>> : _TypeCode<kVector, kVector> { };
+template <> struct TypeCode<PackedStream*> : _TypeCode<kStream> { };
+template <> struct TypeCode<MappedFile*> : _TypeCode<kMappedFile> { };
 
 template <typename T>
 struct is_ext_type : is_ext<TypeCode<T>::code()> {};
@@ -95,52 +115,48 @@ struct PackedVector {
   PackedType type_code;
 };
 
+// Storage comes from the thread's Arena while a call scope is active, see arena.h.
 struct PackedManagedVector {
-  using ManagedType = std::vector<PackedValue>;
-  using ManagedNestedType = std::vector<PackedManagedVector>;
+  using ManagedType = std::vector<PackedValue, ArenaAllocator<PackedValue>>;
+  using ManagedNestedType = std::vector<PackedManagedVector, ArenaAllocator<PackedManagedVector>>;
   PackedVector content{};
-  ManagedType* ptr = nullptr;
-  ManagedNestedType* nested_ptr = nullptr;
+  ManagedType values;
+  ManagedNestedType nested;
   PackedManagedVector(const PackedManagedVector&) = delete;
-  PackedManagedVector(PackedManagedVector&& other) noexcept : content(other.content), ptr(other.ptr), nested_ptr(other.nested_ptr) {
-    other.ptr = nullptr;
-    other.nested_ptr = nullptr;
-  }
-  PackedManagedVector(PackedType type_code, ManagedType* ptr, ManagedNestedType* nested_ptr=nullptr) : ptr(ptr), nested_ptr(nested_ptr) {
-    content.size = ptr->size();
-    content.data = ptr->data();
+  // moving the buffers keeps content.data valid
+  PackedManagedVector(PackedManagedVector&& other) noexcept
+      : content(other.content), values(std::move(other.values)), nested(std::move(other.nested)) { }
+  PackedManagedVector(PackedType type_code, ManagedType values_, ManagedNestedType nested_ = {})
+      : values(std::move(values_)), nested(std::move(nested_)) {
+    content.size = values.size();
+    content.data = values.data();
     content.type_code = type_code;
   }
 
-  ~PackedManagedVector() {
-    delete ptr;
-    delete nested_ptr;
-  }
-
   template <typename T>
   static PackedManagedVector create(const std::vector<T>& vec) {
     const PackedType type_code = PackedTypeCode::TypeCode<T>::transform_code();
     static_assert(type_code != PackedTypeCode::kUnknown);
     static_assert(type_code != PackedTypeCode::kVector);
-    auto ptr = std::make_unique<ManagedType>();
-    ptr->reserve(vec.size());
-    std::transform(vec.begin(), vec.end(), std::back_inserter(*ptr), [](auto&& i){ return transform(i); });
-    return PackedManagedVector(type_code, ptr.release());
+    ManagedType values;
+    values.reserve(vec.size());
+    std::transform(vec.begin(), vec.end(), std::back_inserter(values), [](auto&& i){ return transform(i); });
+    return PackedManagedVector(type_code, std::move(values));
   }
 
   template <typename T>
   static PackedManagedVector create(const std::vector<std::vector<T>>& vec) {
     const PackedType type_code = PackedTypeCode::TypeCode<std::vector<T>>::transform_code();
     static_assert(type_code == PackedTypeCode::kVector);
-    auto ptr = std::make_unique<ManagedType>();
-    auto nested_ptr = std::make_unique<ManagedNestedType>();;
-    ptr->reserve(vec.size());
-    nested_ptr->reserve(vec.size());
+    ManagedType values;
+    ManagedNestedType nested;
+    values.reserve(vec.size());
+    nested.reserve(vec.size());
     for (const auto &i : vec) {
-      nested_ptr->push_back(create(i));
-      ptr->push_back(transform(nested_ptr->back().content));
+      nested.push_back(create(i));
+      values.push_back(transform(nested.back().content));
     }
-    return PackedManagedVector(type_code, ptr.release(), nested_ptr.release());
+    return PackedManagedVector(type_code, std::move(values), std::move(nested));
   }
   template <typename T>
   static PackedValue transform(T&& i);
@@ -148,6 +164,221 @@ struct PackedManagedVector {
 //  static PackedValue transform(const std::vector<T>& i);
 };
 
+// Element type of a tensor, same layout as DLPack's DLDataType.
+struct PackedDType {
+  enum Code : uint8_t {
+    kInt = 0,
+    kUInt = 1,
+    kFloat = 2,
+  };
+  uint8_t code;
+  uint8_t bits;
+  uint16_t lanes;
+
+  template <typename T>
+  static constexpr PackedDType of() {
+    static_assert(std::is_arithmetic<T>::value && !std::is_same<T, bool>::value);
+    return {std::is_floating_point<T>::value ? kFloat : std::is_signed<T>::value ? kInt : kUInt,
+            static_cast<uint8_t>(sizeof(T) * 8), 1};
+  }
+
+  size_t bytes() const {
+    return (bits * lanes + 7) / 8;
+  }
+
+  bool operator==(const PackedDType& other) const {
+    return code == other.code && bits == other.bits && lanes == other.lanes;
+  }
+  bool operator!=(const PackedDType& other) const {
+    return !(*this == other);
+  }
+};
+
+inline std::ostream& operator<<(std::ostream& o, const PackedDType& dtype) {
+  return o << "dtype(" << static_cast<int>(dtype.code) << ", " << static_cast<int>(dtype.bits) << ", " << dtype.lanes << ")";
+}
+
+// Borrowed dense buffer. strides count elements, nullptr means compact row-major.
+struct PackedTensor {
+  void* data;
+  PackedDType dtype;
+  int32_t ndim;
+  const int64_t* shape;
+  const int64_t* strides;
+
+  size_t size() const {
+    size_t r = 1;
+    for (int32_t i = 0; i < ndim; i++) {
+      r *= shape[i];
+    }
+    return r;
+  }
+
+  bool contiguous() const {
+    if (strides == nullptr) {
+      return true;
+    }
+    int64_t expected = 1;
+    for (int32_t i = ndim - 1; i >= 0; i--) {
+      if (shape[i] != 1 && strides[i] != expected) {
+        return false;
+      }
+      expected *= shape[i];
+    }
+    return true;
+  }
+
+  // element offset of the i-th element in row-major order
+  int64_t offset(size_t i) const {
+    if (strides == nullptr) {
+      return static_cast<int64_t>(i);
+    }
+    int64_t r = 0;
+    for (int32_t d = ndim - 1; d >= 0; d--) {
+      r += static_cast<int64_t>(i % shape[d]) * strides[d];
+      i /= shape[d];
+    }
+    return r;
+  }
+
+  template <typename T>
+  T* data_as() const {
+    CHECK_EQ(dtype, PackedDType::of<T>());
+    return reinterpret_cast<T*>(data);
+  }
+};
+
+struct PackedManagedTensor {
+  PackedTensor content{};
+  std::vector<int64_t, ArenaAllocator<int64_t>> shape;
+  std::vector<int64_t, ArenaAllocator<int64_t>> strides;
+  std::vector<unsigned char, ArenaAllocator<unsigned char>> storage;
+
+  PackedManagedTensor(PackedDType dtype, const std::vector<int64_t>& shape_) : shape(shape_.begin(), shape_.end()) {
+    content.dtype = dtype;
+    storage.resize(size_of(shape) * dtype.bytes());
+    bind();
+  }
+  PackedManagedTensor(const PackedManagedTensor&) = delete;
+  PackedManagedTensor(PackedManagedTensor&& other) noexcept
+      : content(other.content), shape(std::move(other.shape)), strides(std::move(other.strides)), storage(std::move(other.storage)) {
+    bind();
+  }
+
+  template <typename T>
+  static PackedManagedTensor create(const std::vector<T>& data, const std::vector<int64_t>& shape) {
+    PackedManagedTensor r(PackedDType::of<T>(), shape);
+    CHECK_EQ(r.content.size(), data.size());
+    std::memcpy(r.storage.data(), data.data(), r.storage.size());
+    return r;
+  }
+
+  template <typename T>
+  T* data() {
+    return content.data_as<T>();
+  }
+
+private:
+  template <typename V>
+  static size_t size_of(const V& shape) {
+    size_t r = 1;
+    for (auto i : shape) {
+      r *= i;
+    }
+    return r;
+  }
+
+  void bind() {
+    content.data = storage.data();
+    content.ndim = static_cast<int32_t>(shape.size());
+    content.shape = shape.data();
+    content.strides = strides.empty() ? nullptr : strides.data();
+  }
+};
+
+// Rows of varying length in one values buffer, row i is values[offsets[i], offsets[i+1]).
+// offsets holds num_rows + 1 entries and starts with 0.
+struct PackedRagged {
+  PackedValue* values;
+  const int64_t* offsets;
+  size_t num_rows;
+  PackedType type_code;
+
+  // number of values in all rows
+  size_t size() const {
+    return num_rows == 0 ? 0 : static_cast<size_t>(offsets[num_rows]);
+  }
+
+  PackedVector row(size_t i) const {
+    return PackedVector{values + offsets[i], static_cast<size_t>(offsets[i + 1] - offsets[i]), type_code};
+  }
+
+  template <typename T>
+  PackedVectorView<T> row_view(size_t i) const {
+    return PackedVectorView<T>(row(i));
+  }
+};
+
+struct PackedManagedRagged {
+  PackedRagged content{};
+  std::vector<PackedValue, ArenaAllocator<PackedValue>> values;
+  std::vector<int64_t, ArenaAllocator<int64_t>> offsets{0};
+
+  explicit PackedManagedRagged(PackedType type_code) {
+    content.type_code = type_code;
+    bind();
+  }
+  PackedManagedRagged(const PackedManagedRagged&) = delete;
+  PackedManagedRagged(PackedManagedRagged&& other) noexcept
+      : content(other.content), values(std::move(other.values)), offsets(std::move(other.offsets)) {
+    bind();
+  }
+
+  // Strings are borrowed from vec like PackedManagedVector::create does.
+  template <typename T>
+  static PackedManagedRagged create(const std::vector<std::vector<T>>& vec);
+
+  template <typename It>
+  void push_row(It begin, It end);
+
+private:
+  void bind() {
+    content.values = values.data();
+    content.offsets = offsets.data();
+    content.num_rows = offsets.size() - 1;
+  }
+};
+
+// Length-prefixed byte string, may hold NULs and need not be terminated.
+struct PackedBytes {
+  const char* data;
+  size_t size;
+
+  std::string_view view() const {
+    return std::string_view(data, size);
+  }
+};
+
+struct PackedManagedBytes {
+  PackedBytes content{};
+  std::string storage;
+
+  explicit PackedManagedBytes(std::string storage_) : storage(std::move(storage_)) {
+    bind();
+  }
+  PackedManagedBytes(const PackedManagedBytes&) = delete;
+  // short strings live inside std::string, so the view is rebound after a move
+  PackedManagedBytes(PackedManagedBytes&& other) noexcept : storage(std::move(other.storage)) {
+    bind();
+  }
+
+private:
+  void bind() {
+    content.data = storage.data();
+    content.size = storage.size();
+  }
+};
+
 struct PackedFunc {
   struct Args;
   struct RetValue;
@@ -157,6 +388,11 @@ struct PackedFunc {
   explicit PackedFunc(FType body) : body_(body) { }
 
   FType body_;
+  // stats_ and name_ exist in every build so the layout does not depend on CTI_ENABLE_STATS/TRACE
+  // set for registered functions, copies count into the same entry
+  FuncStats* stats_ = nullptr;
+  // name of the registry entry, spans of other functions are anonymous
+  const char* name_ = "anonymous";
 
   struct Arg {
   protected:
@@ -190,6 +426,12 @@ struct PackedFunc {
     static Arg from(const char* value) {
       return {PackedTypeCode::kStr, PackedValue{.v_str = value}};
     }
+    static Arg from(const PackedBytes& value) {
+      return {PackedTypeCode::kBytes, PackedValue{.v_voidp = const_cast<PackedBytes*>(&value)}};
+    }
+    static Arg from(const PackedManagedBytes& value) {
+      return from(value.content);
+    }
     static Arg from(const PackedFunc& value) {
       return {PackedTypeCode::kFunc, PackedValue{.v_func = &value}};
     }
@@ -199,11 +441,34 @@ struct PackedFunc {
     static Arg from(const PackedManagedVector& value) {
       return {PackedTypeCode::kVector, PackedValue{.v_vec = &value.content}};
     }
+    static Arg from(const PackedTensor& value) {
+      return {PackedTypeCode::kTensor, PackedValue{.v_voidp = const_cast<PackedTensor*>(&value)}};
+    }
+    static Arg from(const PackedManagedTensor& value) {
+      return from(value.content);
+    }
+    static Arg from(const PackedRagged& value) {
+      return {PackedTypeCode::kRagged, PackedValue{.v_voidp = const_cast<PackedRagged*>(&value)}};
+    }
+    static Arg from(const PackedManagedRagged& value) {
+      return from(value.content);
+    }
+    static Arg from(const MappedFile* value) {
+      return {PackedTypeCode::kMappedFile, PackedValue{.v_voidp = const_cast<MappedFile*>(value)}};
+    }
+    static Arg from(PackedStream* value) {
+      return {PackedTypeCode::kStream, PackedValue{.v_voidp = value}};
+    }
     template <typename T, unsigned _type_code = PackedTypeCode::TypeCode<T>::code(), typename = std::enable_if_t<PackedTypeCode::is_ext<_type_code>::value> >
     static Arg from(const T* value) {
       static_assert(PackedTypeCode::TypeCode<T>::transform_code() == PackedTypeCode::kPtr);
       return {_type_code, PackedValue{.v_voidp = const_cast<T*>(value)}};
     }
+    // the callee borrows the caller's reference
+    template <typename T>
+    static Arg from(const ObjectRef<T>& value) {
+      return from(static_cast<const T*>(value.get()));
+    }
 
     template<typename T,
         typename = typename std::enable_if<
@@ -237,10 +502,23 @@ struct PackedFunc {
     }
 
     operator std::string() {
+      return std::string(operator std::string_view());
+    }
+
+    // borrows kStr or kBytes, only kStr needs a strlen
+    operator std::string_view() {
+      if (type_code() == PackedTypeCode::kBytes) {
+        return reinterpret_cast<const PackedBytes*>(value().v_voidp)->view();
+      }
       CHECK_EQ(type_code(), PackedTypeCode::kStr);
       return value().v_str;
     }
 
+    operator PackedBytes() {
+      std::string_view r = *this;
+      return PackedBytes{r.data(), r.size()};
+    }
+
     operator PackedFunc() {
       CHECK_EQ(type_code(), PackedTypeCode::kFunc);
       return *value().v_func;
@@ -251,18 +529,45 @@ struct PackedFunc {
       return *value().v_vec;
     }
 
+    // a MappedFile starts with the tensor viewing it, see mmap.h
+    operator PackedTensor() {
+      if (type_code() != PackedTypeCode::kMappedFile) {
+        CHECK_EQ(type_code(), PackedTypeCode::kTensor);
+      }
+      return *reinterpret_cast<const PackedTensor*>(value().v_voidp);
+    }
+
+    operator MappedFile*() {
+      CHECK_EQ(type_code(), PackedTypeCode::kMappedFile);
+      return reinterpret_cast<MappedFile*>(value().v_voidp);
+    }
+
+    operator PackedRagged() {
+      CHECK_EQ(type_code(), PackedTypeCode::kRagged);
+      return *reinterpret_cast<const PackedRagged*>(value().v_voidp);
+    }
+
+    operator PackedStream*() {
+      CHECK_EQ(type_code(), PackedTypeCode::kStream);
+      return reinterpret_cast<PackedStream*>(value().v_voidp);
+    }
+
     template <typename T>
     operator std::vector<T>() {
-      CHECK_EQ(type_code(), PackedTypeCode::kVector);
-      std::vector<T> r;
-      CHECK_EQ(value().v_vec->type_code, PackedTypeCode::TypeCode<T>::transform_code());
-      r.reserve(value().v_vec->size);
-      for (size_t i = 0; i < value().v_vec->size; i++) {
-        r.push_back(Arg(value().v_vec->type_code, value().v_vec->data[i]).operator T());
-      }
-      return r;
+      PackedVectorView<T> view = *this;
+      return std::vector<T>(view.begin(), view.end());
     };
 
+    // borrows the vector, elements are converted as they are read
+    template <typename T>
+    operator PackedVectorView<T>() {
+      if (type_code() == PackedTypeCode::kTensor) {
+        return PackedVectorView<T>(*reinterpret_cast<const PackedTensor*>(value().v_voidp));
+      }
+      CHECK_EQ(type_code(), PackedTypeCode::kVector);
+      return PackedVectorView<T>(*value().v_vec);
+    }
+
     template <typename T, typename = std::enable_if_t<PackedTypeCode::is_ext_type<T>::value> >
     operator T*() {
       const PackedType _type_code = PackedTypeCode::TypeCode<T>::code();
@@ -270,20 +575,28 @@ struct PackedFunc {
       CHECK_EQ(type_code(), _type_code);
       return reinterpret_cast<T*>(value().v_voidp);
     }
+
+    template <typename T, typename = std::enable_if_t<PackedTypeCode::is_ext_type<T>::value> >
+    operator ObjectRef<T>() {
+      return ObjectRef<T>(operator T*());
+    }
   };
 
+  // borrowed view of the caller's arrays, which must outlive the call
   struct Args {
-    Args(const std::vector<Arg>& args) : args(args) { }
-    Args(size_t num_args, const PackedType* type_codes, const PackedValue* values) {
-      for (size_t i = 0; i < num_args; i++) {
-        args.emplace_back(type_codes[i], values[i]);
-      }
-    }
+    Args(size_t num_args, const PackedType* type_codes, const PackedValue* values)
+        : num_args(num_args), type_codes(type_codes), values(values) { }
+
+    size_t num_args;
+    const PackedType* type_codes;
+    const PackedValue* values;
 
-    std::vector<Arg> args;
+    size_t size() const {
+      return num_args;
+    }
 
-    Arg& operator [](size_t i) {
-      return args[i];
+    Arg operator [](size_t i) const {
+      return Arg(type_codes[i], values[i]);
     }
   };
 
@@ -301,20 +614,61 @@ struct PackedFunc {
     inline static Deleter deleter_for() {
       return [](void*p){ return std::default_delete<T>()(reinterpret_cast<T*>(p)); };
     }
+    // for objects placed in an Arena, whose memory goes back on reset
+    template <typename T>
+    inline static Deleter destructor_for() {
+      return [](void*p){ reinterpret_cast<T*>(p)->~T(); };
+    }
     template <typename T>
     inline static Copy copy_for() {
       return [](const void*p) { return new T(*reinterpret_cast<const T*>(p)); };
     }
 
-    static std::unique_ptr<void, Manager> make(const char* str, int len=-1) {
-      return std::unique_ptr<void, Manager>(new std::string(str, len), Manager(deleter_for<std::string>()));
+    // Builds T in the current Arena if there is one, on the heap otherwise.
+    template <typename T, typename... Args>
+    static std::unique_ptr<void, Manager> emplace(Args&&... args) {
+      if (Arena* arena = Arena::Current()) {
+        return std::unique_ptr<void, Manager>(arena->create<T>(std::forward<Args>(args)...), Manager(destructor_for<T>()));
+      }
+      return std::unique_ptr<void, Manager>(new T(std::forward<Args>(args)...), Manager(deleter_for<T>()));
+    }
+
+    // a nul-terminated copy of str, p.get() is the char array
+    static std::unique_ptr<void, Manager> make(const char* str, size_t len=std::string::npos) {
+      if (len == std::string::npos) {
+        len = std::strlen(str);
+      }
+      char* r = nullptr;
+      Manager manager(destructor_for<char>());
+      if (Arena* arena = Arena::Current()) {
+        r = static_cast<char*>(arena->allocate(len + 1, 1));
+      } else {
+        r = new char[len + 1];
+        manager = Manager([](void* p) { delete[] static_cast<char*>(p); });
+      }
+      std::memcpy(r, str, len);
+      r[len] = '\0';
+      return std::unique_ptr<void, Manager>(r, std::move(manager));
+    };
+    // holds a reference the caller already took, dropped with the result
+    template <typename T>
+    static std::unique_ptr<void, Manager> adopt(T* obj) {
+      return std::unique_ptr<void, Manager>(obj, Manager([](void* p) { static_cast<T*>(p)->DecRef(); }));
+    }
+    template <typename T>
+    static std::unique_ptr<void, Manager> make(const T& v) {
+      return emplace<T>(v);
     };
     template <typename T>
-    static std::unique_ptr<void, Manager> make(const T& v, Deleter deleter = deleter_for<T>()) {
+    static std::unique_ptr<void, Manager> make(const T* v) {
+      return emplace<T>(*v);
+    };
+    template <typename T>
+    static std::unique_ptr<void, Manager> make(const T& v, Deleter deleter) {
       return std::unique_ptr<void, Manager>(new T(v), Manager(deleter));
     };
     template <typename T>
-    static std::unique_ptr<void, Manager> make(const T* v, Deleter deleter = deleter_for<T>()) {
+    static std::unique_ptr<void, Manager> make(const T* v, Deleter deleter) {
       return std::unique_ptr<void, Manager>(new T(*v), Manager(deleter));
     };
     template <typename T>
@@ -329,7 +683,13 @@ struct PackedFunc {
       return std::unique_ptr<void, Manager>(nullptr, Manager(deleter_for<std::nullptr_t>()));
     };
     static std::unique_ptr<void, Manager> make(PackedManagedVector vec) {
-      return std::unique_ptr<void, Manager>(new PackedManagedVector(std::move(vec)), Manager(deleter_for<PackedManagedVector>()));
+      return emplace<PackedManagedVector>(std::move(vec));
+    };
+    static std::unique_ptr<void, Manager> make(PackedManagedTensor tensor) {
+      return emplace<PackedManagedTensor>(std::move(tensor));
+    };
+    static std::unique_ptr<void, Manager> make(PackedManagedRagged ragged) {
+      return emplace<PackedManagedRagged>(std::move(ragged));
     };
     Deleter deleter;
   };
@@ -372,18 +732,34 @@ struct PackedFunc {
     RetValue& reset(const char* value, bool copy=true) {
       if (copy) {
         p = Manager::make(value);
-        value = reinterpret_cast<std::string*>(p.get())->c_str();
+        value = reinterpret_cast<const char*>(p.get());
       }
       return switch_to(PackedTypeCode::kStr, PackedValue{.v_str = value}, copy);
     }
     RetValue& reset(const std::string& value, bool copy=true) {
       const char* value_ = value.c_str();
       if (copy) {
-        p = Manager::make(value);
-        value_ = reinterpret_cast<std::string*>(p.get())->c_str();
+        p = Manager::make(value.c_str(), value.size());
+        value_ = reinterpret_cast<const char*>(p.get());
       }
       return switch_to(PackedTypeCode::kStr, PackedValue{.v_str = value_}, copy);
     }
+    // takes the payload over instead of copying it
+    RetValue& reset(std::string&& value) {
+      p = Manager::emplace<std::string>(std::move(value));
+      return switch_to(PackedTypeCode::kStr, PackedValue{.v_str = reinterpret_cast<std::string*>(p.get())->c_str()}, true);
+    }
+    RetValue& reset(const PackedBytes& value, bool copy=true) {
+      if (copy) {
+        return reset(PackedManagedBytes(std::string(value.view())));
+      }
+      return switch_to(PackedTypeCode::kBytes, PackedValue{.v_voidp = const_cast<PackedBytes*>(&value)});
+    }
+    RetValue& reset(PackedManagedBytes value) {
+      p = Manager::emplace<PackedManagedBytes>(std::move(value));
+      PackedBytes* value_ = &reinterpret_cast<PackedManagedBytes*>(p.get())->content;
+      return switch_to(PackedTypeCode::kBytes, PackedValue{.v_voidp = value_}, true);
+    }
     RetValue& reset(const PackedFunc& value, bool copy=true) {
       const PackedFunc* value_ = &value;
       if (copy) {
@@ -405,12 +781,75 @@ struct PackedFunc {
     }
     template <typename T, unsigned _type_code = PackedTypeCode::TypeCode<T>::code(), typename = std::enable_if_t<PackedTypeCode::is_ext<_type_code>::value> >
     RetValue& reset(const T* value, bool copy=PackedTypeCode::TypeCode<T>::copy()) {
+      if constexpr (std::is_base_of<Object, T>::value) {
+        // shared instead of copied, the result holds a reference until it is dropped
+        return reset(ObjectRef<T>(const_cast<T*>(value)));
+      }
       if (copy) {
         p = Manager::make(value);
         value = reinterpret_cast<T*>(p.get());
       }
       return switch_to(_type_code, PackedValue{.v_voidp = const_cast<T*>(value)}, copy);
     }
+    template <typename T, unsigned _type_code = PackedTypeCode::TypeCode<T>::code(), typename = std::enable_if_t<PackedTypeCode::is_ext<_type_code>::value> >
+    RetValue& reset(ObjectRef<T> value) {
+      T* value_ = value.release();
+      p = Manager::adopt(value_);
+      return switch_to(_type_code, PackedValue{.v_voidp = value_}, true);
+    }
+    RetValue& reset(PackedManagedTensor value) {
+      p = Manager::make(std::move(value));
+      PackedTensor* value_ = &reinterpret_cast<PackedManagedTensor*>(p.get())->content;
+      return switch_to(PackedTypeCode::kTensor, PackedValue{.v_voidp = value_}, true);
+    }
+    RetValue& reset(PackedManagedRagged value) {
+      p = Manager::make(std::move(value));
+      PackedRagged* value_ = &reinterpret_cast<PackedManagedRagged*>(p.get())->content;
+      return switch_to(PackedTypeCode::kRagged, PackedValue{.v_voidp = value_}, true);
+    }
+    // the mapping is handed over to the caller, who releases it
+    RetValue& reset(MappedFile* value) {
+      return switch_to(PackedTypeCode::kMappedFile, PackedValue{.v_voidp = value});
+    }
+    // the stream is handed over to the caller, who closes it
+    RetValue& reset(PackedStream* value) {
+      return switch_to(PackedTypeCode::kStream, PackedValue{.v_voidp = value});
+    }
+    RetValue& reset(PackedManagedVector value) {
+      p = Manager::make(std::move(value));
+      const PackedVector* value_ = &reinterpret_cast<PackedManagedVector*>(p.get())->content;
+      return switch_to(PackedTypeCode::kVector, PackedValue{.v_vec = value_}, true);
+    }
+    // bytes of data the result owns, 0 for values it only refers to
+    size_t owned_bytes() const {
+      if (p == nullptr) {
+        return 0;
+      }
+      switch (type_code()) {
+        case PackedTypeCode::kStr:
+          return std::strlen(value().v_str) + 1;
+        case PackedTypeCode::kBytes:
+          return reinterpret_cast<const PackedBytes*>(value().v_voidp)->size;
+        case PackedTypeCode::kVector:
+          return value().v_vec->size * sizeof(PackedValue);
+        case PackedTypeCode::kTensor: {
+          const PackedTensor* t = reinterpret_cast<const PackedTensor*>(value().v_voidp);
+          return t->size() * t->dtype.bytes();
+        }
+        case PackedTypeCode::kRagged: {
+          const PackedRagged* r = reinterpret_cast<const PackedRagged*>(value().v_voidp);
+          return r->size() * sizeof(PackedValue) + (r->num_rows + 1) * sizeof(int64_t);
+        }
+        default:
+          return 0;
+      }
+    }
+
+    // takes over value, which deleter frees along with the result
+    RetValue& reset(PackedType type_code, void* value, Manager::Deleter deleter) {
+      p = Manager::PtrType(value, Manager(std::move(deleter)));
+      return switch_to(type_code, PackedValue{.v_voidp = value}, true);
+    }
     RetValue& reset(RetValue&& other) {
       p = std::move(other.p);
       return switch_to(other.content_.type_code, other.content_.value, p!=nullptr);
@@ -419,24 +858,115 @@ struct PackedFunc {
 
   RetValue call_packed(const Args &args) const {
     RetValue rv;
+#if CTI_ENABLE_TRACE
+    Trace::Span span(name_, args.num_args, args.type_codes);
+#endif
+#if CTI_ENABLE_STATS
+    if (stats_ != nullptr && FuncStats::Enabled()) {
+      const uint64_t start = FuncStats::Now();
+      body_(args, &rv);
+      stats_->record(FuncStats::Now() - start, rv.owned_bytes());
+      return rv;
+    }
+#endif
     body_(args, &rv);
     return rv;
   }
 
   template <typename... ArgTps>
   RetValue operator()(ArgTps&& ...args) const {
-    std::vector<Arg> packed_args{ Arg::from(std::forward<ArgTps>(args))... };
-    return call_packed(Args(packed_args));
+    constexpr size_t num_args = sizeof...(ArgTps);
+    const std::array<Arg, num_args> packed_args{ Arg::from(std::forward<ArgTps>(args))... };
+    std::array<PackedType, num_args> type_codes;
+    std::array<PackedValue, num_args> values;
+    for (size_t i = 0; i < num_args; i++) {
+      type_codes[i] = packed_args[i].type_code();
+      values[i] = packed_args[i].value();
+    }
+    return call_packed(Args(num_args, type_codes.data(), values.data()));
   }
 
+  // Results of FuncCall and FuncCallBatch live in the thread's Arena until the next top-level
+  // call of either on the same thread, which drops them before resetting the arena.
   static void FuncCall(const void* handle, size_t num_args, const PackedType* type_codes, const PackedValue* values, PackedType* ret_type, PackedValue* ret_val) {
     Args args(num_args, type_codes, values);
-    // TODO: better memory manager
-    static thread_local RetValue rv;
+    if (Arena::Depth() == 0) {
+      ReleaseLocalResults();
+    }
+    Arena::Scope scope;
+    RetValue& rv = LocalRetValue();
     rv.reset(reinterpret_cast<const PackedFunc*>(handle)->call_packed(args));
     *ret_type = rv.type_code();
     *ret_val = rv.value();
   }
+
+  // Like FuncCall, but the result lives in a slab slot owned by the caller until RetValueRelease.
+  static void FuncCallOwned(const void* handle, size_t num_args, const PackedType* type_codes, const PackedValue* values,
+      void** ret_handle, PackedType* ret_type, PackedValue* ret_val) {
+    Args args(num_args, type_codes, values);
+    RetValue* rv = Slab<RetValue>::New();
+    // the result outlives any call scope
+    Arena::Suspend suspend;
+    rv->reset(reinterpret_cast<const PackedFunc*>(handle)->call_packed(args));
+    *ret_handle = rv;
+    *ret_type = rv->type_code();
+    *ret_val = rv->value();
+  }
+
+  static void RetValueRelease(void* ret_handle) {
+    Slab<RetValue>::Delete(reinterpret_cast<RetValue*>(ret_handle));
+  }
+
+  static void FuncCallBatch(const void* handle, size_t num_calls, size_t num_args, const PackedType* type_codes, const PackedValue* values,
+      PackedType* ret_types, PackedValue* ret_vals) {
+    if (Arena::Depth() == 0) {
+      ReleaseLocalResults();
+    }
+    Arena::Scope scope;
+    // a batch made from a batched body keeps its results apart from the batch running it
+    std::deque<std::vector<RetValue>>& batches = LocalBatches();
+    size_t& depth = LocalBatchDepth();
+    if (batches.size() == depth) {
+      batches.emplace_back();
+    }
+    std::vector<RetValue>& rvs = batches[depth++];
+    const PackedFunc* func = reinterpret_cast<const PackedFunc*>(handle);
+    rvs.clear();
+    rvs.resize(num_calls);
+    for (size_t i = 0; i < num_calls; i++) {
+      Args args(num_args, type_codes + i * num_args, values + i * num_args);
+      rvs[i].reset(func->call_packed(args));
+      ret_types[i] = rvs[i].type_code();
+      ret_vals[i] = rvs[i].value();
+    }
+    depth--;
+  }
+
+private:
+  static RetValue& LocalRetValue() {
+    static thread_local RetValue rv;
+    return rv;
+  }
+
+  // one vector per nesting level of batches, a deque so that growing keeps outer levels in place
+  static std::deque<std::vector<RetValue>>& LocalBatches() {
+    static thread_local std::deque<std::vector<RetValue>> batches;
+    return batches;
+  }
+
+  static size_t& LocalBatchDepth() {
+    static thread_local size_t depth = 0;
+    return depth;
+  }
+
+  static void ReleaseLocalResults() {
+    // made first so that it is destroyed after the results at thread exit
+    Arena::Local();
+    LocalRetValue().switch_to(PackedTypeCode::kUnknown, PackedValue{.v_voidp = nullptr});
+    for (auto& rvs : LocalBatches()) {
+      rvs.clear();
+    }
+  }
 };
 
 template <typename T>
@@ -444,6 +974,397 @@ PackedValue PackedManagedVector::transform(T&& i) {
   return PackedFunc::Arg::from(i).value();
 }
 
+template <typename T>
+PackedManagedRagged PackedManagedRagged::create(const std::vector<std::vector<T>>& vec) {
+  const PackedType type_code = PackedTypeCode::TypeCode<T>::transform_code();
+  static_assert(type_code != PackedTypeCode::kUnknown);
+  static_assert(type_code != PackedTypeCode::kVector);
+  PackedManagedRagged r(type_code);
+  size_t size = 0;
+  for (const auto& row : vec) {
+    size += row.size();
+  }
+  r.values.reserve(size);
+  r.offsets.reserve(vec.size() + 1);
+  for (const auto& row : vec) {
+    r.push_row(row.begin(), row.end());
+  }
+  return r;
+}
+
+template <typename It>
+void PackedManagedRagged::push_row(It begin, It end) {
+  for (; begin != end; ++begin) {
+    values.push_back(PackedManagedVector::transform(*begin));
+  }
+  offsets.push_back(static_cast<int64_t>(values.size()));
+  bind();
+}
+
+// Chunks produced on demand, body fills rv with the next chunk or returns false once exhausted.
+// A stream is used from one thread at a time.
+struct PackedStream {
+  using FType = std::function<bool (PackedFunc::RetValue* rv)>;
+
+  explicit PackedStream(FType body) : body_(std::move(body)) { }
+
+  // the chunk stays valid until the following call
+  bool next() {
+    current_.switch_to(PackedTypeCode::kUnknown, PackedValue{.v_voidp = nullptr});
+    if (done_ || !body_(&current_)) {
+      done_ = true;
+      return false;
+    }
+    return true;
+  }
+
+  PackedFunc::RetValue& current() {
+    return current_;
+  }
+
+private:
+  FType body_;
+  PackedFunc::RetValue current_;
+  bool done_ = false;
+};
+
+// Packed type code expected for an argument of type T, and its conversion without checks.
+template <typename T, typename Enabled = void>
+struct ArgTraits;
+
+template <typename T>
+struct ArgTraits<T, typename std::enable_if_t<std::is_integral<T>::value>> {
+  static constexpr PackedType code = PackedTypeCode::kInt64;
+  static T unpack(PackedValue v) {
+    // narrower types are range checked like Arg::operator int()
+    if constexpr (sizeof(T) < sizeof(int64_t)) {
+      CHECK(v.v_int64 >= static_cast<int64_t>(std::numeric_limits<T>::min()) &&
+          v.v_int64 <= static_cast<int64_t>(std::numeric_limits<T>::max())) << "get " << v.v_int64 << " out of range ";
+    }
+    return static_cast<T>(v.v_int64);
+  }
+};
+
+template <> struct ArgTraits<double> {
+  static constexpr PackedType code = PackedTypeCode::kFloat64;
+  static double unpack(PackedValue v) { return v.v_float64; }
+};
+
+template <> struct ArgTraits<const char*> {
+  static constexpr PackedType code = PackedTypeCode::kStr;
+  static const char* unpack(PackedValue v) { return v.v_str; }
+};
+
+template <> struct ArgTraits<std::string> {
+  static constexpr PackedType code = PackedTypeCode::kStr;
+  static std::string unpack(PackedValue v) { return v.v_str; }
+};
+
+template <> struct ArgTraits<std::string_view> {
+  static constexpr PackedType code = PackedTypeCode::kStr;
+  static std::string_view unpack(PackedValue v) { return v.v_str; }
+};
+
+template <> struct ArgTraits<PackedBytes> {
+  static constexpr PackedType code = PackedTypeCode::kBytes;
+  static const PackedBytes& unpack(PackedValue v) { return *reinterpret_cast<const PackedBytes*>(v.v_voidp); }
+};
+
+template <> struct ArgTraits<PackedFunc> {
+  static constexpr PackedType code = PackedTypeCode::kFunc;
+  static const PackedFunc& unpack(PackedValue v) { return *v.v_func; }
+};
+
+template <> struct ArgTraits<PackedVector> {
+  static constexpr PackedType code = PackedTypeCode::kVector;
+  static const PackedVector& unpack(PackedValue v) { return *v.v_vec; }
+};
+
+template <> struct ArgTraits<PackedTensor> {
+  static constexpr PackedType code = PackedTypeCode::kTensor;
+  static const PackedTensor& unpack(PackedValue v) { return *reinterpret_cast<const PackedTensor*>(v.v_voidp); }
+};
+
+template <> struct ArgTraits<PackedRagged> {
+  static constexpr PackedType code = PackedTypeCode::kRagged;
+  static const PackedRagged& unpack(PackedValue v) { return *reinterpret_cast<const PackedRagged*>(v.v_voidp); }
+};
+
+template <> struct ArgTraits<MappedFile*> {
+  static constexpr PackedType code = PackedTypeCode::kMappedFile;
+  static MappedFile* unpack(PackedValue v) { return reinterpret_cast<MappedFile*>(v.v_voidp); }
+};
+
+template <> struct ArgTraits<PackedStream*> {
+  static constexpr PackedType code = PackedTypeCode::kStream;
+  static PackedStream* unpack(PackedValue v) { return reinterpret_cast<PackedStream*>(v.v_voidp); }
+};
+
+template <typename T>
+struct ArgTraits<std::vector<T>> {
+  static constexpr PackedType code = PackedTypeCode::kVector;
+  // element type codes are not part of the signature, so they are still checked here
+  static std::vector<T> unpack(PackedValue v) { return PackedFunc::Arg(code, v).operator std::vector<T>(); }
+};
+
+template <typename T>
+struct ArgTraits<T*, typename std::enable_if_t<PackedTypeCode::is_ext_type<T>::value>> {
+  static constexpr PackedType code = PackedTypeCode::TypeCode<T>::code();
+  static T* unpack(PackedValue v) { return reinterpret_cast<T*>(v.v_voidp); }
+};
+
+template <typename T>
+struct ArgTraits<ObjectRef<T>, typename std::enable_if_t<PackedTypeCode::is_ext_type<T>::value>> {
+  static constexpr PackedType code = PackedTypeCode::TypeCode<T>::code();
+  static ObjectRef<T> unpack(PackedValue v) { return ObjectRef<T>(reinterpret_cast<T*>(v.v_voidp)); }
+};
+
+// Read-only view of a kVector with elements of type T, the element type is checked once
+// when the view is made, so reading never allocates nor checks again.
+template <typename T>
+struct PackedVectorView {
+  using reference = decltype(ArgTraits<T>::unpack(std::declval<PackedValue>()));
+  using value_type = std::decay_t<reference>;
+
+  struct iterator {
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = PackedVectorView::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = PackedVectorView::reference;
+
+    const PackedValue* p;
+
+    reference operator*() const { return ArgTraits<T>::unpack(*p); }
+    reference operator[](difference_type n) const { return ArgTraits<T>::unpack(p[n]); }
+    iterator& operator++() { ++p; return *this; }
+    iterator operator++(int) { return iterator{p++}; }
+    iterator& operator--() { --p; return *this; }
+    iterator operator--(int) { return iterator{p--}; }
+    iterator& operator+=(difference_type n) { p += n; return *this; }
+    iterator& operator-=(difference_type n) { p -= n; return *this; }
+    iterator operator+(difference_type n) const { return iterator{p + n}; }
+    iterator operator-(difference_type n) const { return iterator{p - n}; }
+    difference_type operator-(const iterator& other) const { return p - other.p; }
+    bool operator==(const iterator& other) const { return p == other.p; }
+    bool operator!=(const iterator& other) const { return p != other.p; }
+    bool operator<(const iterator& other) const { return p < other.p; }
+    bool operator>(const iterator& other) const { return p > other.p; }
+    bool operator<=(const iterator& other) const { return p <= other.p; }
+    bool operator>=(const iterator& other) const { return p >= other.p; }
+  };
+
+  // ext values are stored in vectors as kPtr
+  static constexpr PackedType element_code =
+      PackedTypeCode::is_ext<ArgTraits<T>::code>::value ? PackedTypeCode::kPtr : ArgTraits<T>::code;
+
+  PackedVectorView() = default;
+  // CHECK only logs, so a vector or tensor that does not match is viewed as empty rather than read
+  explicit PackedVectorView(const PackedVector& vec) {
+    // an empty vector built from nothing has no element type
+    if (vec.size != 0) {
+      CHECK_EQ(vec.type_code, element_code);
+      if (vec.type_code != element_code) {
+        return;
+      }
+    }
+    data_ = vec.data;
+    size_ = vec.size;
+  }
+
+  // A compact 1-d int64 or float64 tensor is laid out like a vector of kInt64 or kFloat64 values,
+  // so typed buffers from the hosts are read in place.
+  explicit PackedVectorView(const PackedTensor& t) {
+    static_assert(sizeof(PackedValue) == sizeof(int64_t) && sizeof(PackedValue) == sizeof(double));
+    if (element_code != PackedTypeCode::kInt64 && element_code != PackedTypeCode::kFloat64) {
+      FATAL() << "a tensor could not be viewed as a vector of type " << element_code;
+      return;
+    }
+    const PackedDType dtype = element_code == PackedTypeCode::kInt64 ? PackedDType::of<int64_t>() : PackedDType::of<double>();
+    if (t.ndim != 1 || !t.contiguous() || !(t.dtype == dtype)) {
+      FATAL() << "a tensor viewed as a vector should be 1-d, compact and of " << dtype << ", got " << t.ndim << "-d of " << t.dtype;
+      return;
+    }
+    data_ = static_cast<const PackedValue*>(t.data);
+    size_ = t.size();
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  reference operator[](size_t i) const { return ArgTraits<T>::unpack(data_[i]); }
+  iterator begin() const { return iterator{data_}; }
+  iterator end() const { return iterator{data_ + size_}; }
+
+private:
+  const PackedValue* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+template <typename T>
+struct ArgTraits<PackedVectorView<T>> {
+  static constexpr PackedType code = PackedTypeCode::kVector;
+  static PackedVectorView<T> unpack(PackedValue v) { return PackedVectorView<T>(*v.v_vec); }
+};
+
+template <typename F>
+struct FunctionSignature : FunctionSignature<decltype(&F::operator())> { };
+
+template <typename R, typename... Ts>
+struct FunctionSignature<R(*)(Ts...)> {
+  using Type = R(Ts...);
+};
+
+template <typename R, typename C, typename... Ts>
+struct FunctionSignature<R(C::*)(Ts...)> {
+  using Type = R(Ts...);
+};
+
+template <typename R, typename C, typename... Ts>
+struct FunctionSignature<R(C::*)(Ts...) const> {
+  using Type = R(Ts...);
+};
+
+template <typename FType>
+struct TypedPackedFunc;
+
+template <typename R, typename... Ts>
+struct TypedPackedFunc<R(Ts...)> {
+  static constexpr size_t num_args = sizeof...(Ts);
+  static constexpr std::array<PackedType, num_args> signature{ { ArgTraits<std::decay_t<Ts>>::code... } };
+
+  // Wrap f so that a call whose type codes match the signature is unpacked without per-argument checks,
+  // anything else goes through the checked Arg conversions.
+  template <typename F>
+  static PackedFunc make(F f) {
+    return PackedFunc([f](PackedFunc::Args args, PackedFunc::RetValue* rv) {
+      // type_codes and signature.data() may be null without arguments, memcmp must not see them
+      if (args.size() == num_args && (num_args == 0 || std::memcmp(args.type_codes, signature.data(), num_args * sizeof(PackedType)) == 0)) {
+        invoke_unchecked(f, args, rv, std::index_sequence_for<Ts...>{});
+      } else if (args.size() != num_args) {
+        CHECK_EQ(args.size(), num_args);
+      } else {
+        invoke_checked(f, args, rv, std::index_sequence_for<Ts...>{});
+      }
+    });
+  }
+
+private:
+  template <typename T>
+  static T convert(PackedFunc::Arg arg) {
+    return arg;
+  }
+
+  template <typename F, typename... Us>
+  static void invoke(const F& f, PackedFunc::RetValue* rv, Us&&... us) {
+    if constexpr (std::is_void<R>::value) {
+      f(std::forward<Us>(us)...);
+      rv->reset(0);
+    } else {
+      rv->reset(f(std::forward<Us>(us)...));
+    }
+  }
+
+  template <typename F, size_t... I>
+  static void invoke_unchecked(const F& f, const PackedFunc::Args& args, PackedFunc::RetValue* rv, std::index_sequence<I...>) {
+    invoke(f, rv, ArgTraits<std::decay_t<Ts>>::unpack(args.values[I])...);
+  }
+
+  template <typename F, size_t... I>
+  static void invoke_checked(const F& f, const PackedFunc::Args& args, PackedFunc::RetValue* rv, std::index_sequence<I...>) {
+    invoke(f, rv, convert<std::decay_t<Ts>>(args[I])...);
+  }
+};
+
+// Scalar kernel over int64/double that also runs columnar: when every argument is a kVector
+// of the matching element type, f is applied elementwise in a single loop producing a kVector.
+template <typename FType>
+struct ElementwisePackedFunc;
+
+template <typename R, typename... Ts>
+struct ElementwisePackedFunc<R(Ts...)> {
+  static constexpr size_t num_args = sizeof...(Ts);
+  static_assert(num_args > 0);
+  // the types ArgTraits unpacks from kInt64 and kFloat64
+  template <typename T>
+  static constexpr bool is_number = std::is_integral<T>::value || std::is_same<T, double>::value;
+  static_assert((is_number<std::decay_t<Ts>> && ...) && is_number<R>,
+      "elementwise kernel should take and return integers or double");
+
+  template <typename F>
+  static PackedFunc make(F f) {
+    PackedFunc scalar = TypedPackedFunc<R(Ts...)>::make(f);
+    return PackedFunc([f, scalar](PackedFunc::Args args, PackedFunc::RetValue* rv) {
+      bool columnar = args.size() == num_args;
+      for (size_t i = 0; columnar && i < num_args; i++) {
+        columnar = args.type_codes[i] == PackedTypeCode::kVector;
+      }
+      if (columnar) {
+        map(f, args, rv, std::index_sequence_for<Ts...>{});
+      } else {
+        scalar.body_(args, rv);
+      }
+    });
+  }
+
+private:
+  template <typename T>
+  static T& field(PackedValue& v) {
+    if constexpr (std::is_floating_point<T>::value) {
+      return v.v_float64;
+    } else {
+      return v.v_int64;
+    }
+  }
+
+  template <typename F, size_t... I>
+  static void map(const F& f, const PackedFunc::Args& args, PackedFunc::RetValue* rv, std::index_sequence<I...>) {
+    const std::array<const PackedVector*, num_args> vecs{ { args.values[I].v_vec... } };
+    const size_t size = vecs[0]->size;
+    constexpr std::array<PackedType, num_args> element_codes{ { ArgTraits<std::decay_t<Ts>>::code... } };
+    // empty vectors may have no element type, as for PackedVectorView
+    for (size_t i = 0; i < num_args; i++) {
+      if (vecs[i]->size != size || (size != 0 && vecs[i]->type_code != element_codes[i])) {
+        CHECK_EQ(vecs[i]->size, size);
+        CHECK_EQ(vecs[i]->type_code, element_codes[i]);
+        return;
+      }
+    }
+    const std::array<const PackedValue*, num_args> in{ { vecs[I]->data... } };
+    PackedManagedVector::ManagedType out(size);
+    PackedValue* o = out.data();
+    using RField = std::conditional_t<std::is_floating_point<R>::value, double, int64_t>;
+    CTI_PRAGMA_SIMD
+    for (size_t i = 0; i < size; i++) {
+      field<RField>(o[i]) = static_cast<RField>(f(ArgTraits<std::decay_t<Ts>>::unpack(in[I][i])...));
+    }
+    rv->reset(PackedManagedVector(ArgTraits<R>::code, std::move(out)));
+  }
+};
+
+namespace ops {
+
+template <typename T>
+struct Add {
+  T operator()(T a, T b) const { return a + b; }
+};
+
+template <typename T>
+struct Sub {
+  T operator()(T a, T b) const { return a - b; }
+};
+
+template <typename T>
+struct Mul {
+  T operator()(T a, T b) const { return a * b; }
+};
+
+template <typename T>
+struct Div {
+  T operator()(T a, T b) const { return a / b; }
+};
+
+}
+
 template<>
 struct _Registry<PackedFunc> : public _Registry_Base<PackedFunc> {
 public:
@@ -451,12 +1372,34 @@ public:
   using typename _Registry_Base<Type>::RegistryType;
 protected:
   Type content_;
+  FuncStats stats_;
+  std::string trace_name_;
   _Registry() = default;
+
+  RegistryType& set_content(PackedFunc content) {
+    // TODO: dynamic_cast is not that safe here?
+    RegistryType* self = dynamic_cast<RegistryType*>(this);
+    content_ = std::move(content);
+    content_.stats_ = &stats_;
+    trace_name_ = self->name();
+    content_.name_ = trace_name_.c_str();
+    return *self;
+  }
 public:
   RegistryType& set_body(PackedFunc::FType content) {
-    content_ = PackedFunc(std::move(content));
-    // TODO: dynamic_cast is not that safe here?
-    return *dynamic_cast<RegistryType*>(this);
+    return set_content(PackedFunc(std::move(content)));
+  }
+
+  // Signature is deduced from f, which can be a function pointer or a non-generic lambda.
+  template <typename F>
+  RegistryType& set_typed_body(F f) {
+    return set_content(TypedPackedFunc<typename FunctionSignature<F>::Type>::make(std::move(f)));
+  }
+
+  // Register a scalar numeric kernel that is also callable with kVector columns, see ElementwisePackedFunc.
+  template <typename F>
+  RegistryType& set_elementwise_body(F f) {
+    return set_content(ElementwisePackedFunc<typename FunctionSignature<F>::Type>::make(std::move(f)));
   }
 
   PackedFunc* get() override {
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include "packedfunc.h"
+
+namespace ctypes {
+
+// Work-stealing scheduler for fork-join loops. Each worker splits its range lazily and keeps the
+// halves in its own deque, idle workers steal the oldest half from another deque.
+struct Scheduler {
+  using Body = std::function<void(size_t begin, size_t end)>;
+
+  struct Stats {
+    size_t num_threads;
+    uint64_t calls;
+    uint64_t tasks;
+    uint64_t steals;
+  };
+
+  static Scheduler* Global();
+
+  // num_workers threads besides the callers of parallel_for
+  explicit Scheduler(size_t num_workers);
+  ~Scheduler();
+
+  // Run body over [0, n) in chunks of at least grain (0 picks one), the calling thread takes part.
+  void parallel_for(size_t n, const Body& body, size_t grain = 0);
+
+  // threads running tasks, including one caller
+  size_t num_threads() const {
+    return workers.size() + 1;
+  }
+
+  Stats stats() const;
+
+private:
+  struct Job {
+    const Body* body;
+    size_t grain;
+    std::atomic<size_t> remaining;
+  };
+
+  struct Task {
+    Job* job;
+    size_t begin;
+    size_t end;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void run(size_t index);
+  void push(size_t index, Task task);
+  bool pop(size_t index, Task* task);
+  void execute(size_t index, Task task);
+  size_t local_index() const;
+
+  std::vector<std::thread> workers;
+  // one per worker, the last one is shared by outside callers
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::atomic<size_t> num_queued{0};
+  std::mutex sleep_mutex;
+  std::condition_variable sleep_cv;
+  bool stopped = false;
+
+  std::atomic<uint64_t> calls{0};
+  std::atomic<uint64_t> tasks{0};
+  std::atomic<uint64_t> steals{0};
+};
+
+}
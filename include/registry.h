@@ -39,14 +39,56 @@ public:
 template <typename T>
 struct Registry : public _Registry<T> {
 private:
+  // immutable sorted view of fmap, keys point into the map nodes
+  struct Snapshot {
+    std::vector<std::pair<std::string_view, Registry*>> entries;
+
+    Registry* find(std::string_view name) const {
+      auto it = std::lower_bound(entries.begin(), entries.end(), name, [](const auto& kv, std::string_view n) {
+        return kv.first < n;
+      });
+      if (it == entries.end() || it->first != name) {
+        return nullptr;
+      }
+      return it->second;
+    }
+  };
+
   struct Manager {
     static Manager* Global() {
       static Manager inst;
       return &inst;
     }
 
-    std::map<std::string, Registry*> fmap;
+    // should hold mutex
+    void publish() {
+      auto s = std::make_unique<Snapshot>();
+      s->entries.reserve(fmap.size());
+      for (const auto &kv : fmap) {
+        s->entries.emplace_back(kv.first, kv.second);
+      }
+      snapshot.store(s.get(), std::memory_order_release);
+      stale.store(false, std::memory_order_release);
+      // readers never lock, so retired generations live as long as the manager
+      generations.push_back(std::move(s));
+    }
+
+    // should hold mutex. Late entries are looked up under the mutex until the map has doubled,
+    // so generations at least double in size and all of them hold less than twice the entries.
+    void register_late() {
+      if (fmap.size() >= 2 * snapshot.load(std::memory_order_relaxed)->entries.size()) {
+        publish();
+      } else {
+        stale.store(true, std::memory_order_release);
+      }
+    }
+
+    std::map<std::string, Registry*, std::less<>> fmap;
     std::mutex mutex;
+    std::atomic<const Snapshot*> snapshot{nullptr};
+    // entries registered since the last publish are only in fmap
+    std::atomic<bool> stale{false};
+    std::vector<std::unique_ptr<Snapshot>> generations;
   };
 
   std::string name_;
@@ -65,6 +107,9 @@ public:
       auto r = new Registry();
       r->name_ = name;
       m->fmap[name] = r;
+      if (m->snapshot.load(std::memory_order_relaxed) != nullptr) {
+        m->register_late();
+      }
       return *r;
     } else {
       FATAL() << "Global registry " << name << " is already registered in " << RegistryName_;
@@ -72,8 +117,29 @@ public:
     }
   }
 
-  static Type* Get(const std::string &name) {
+  // Publish the registered set as an immutable snapshot, after which Get takes no lock.
+  // Later Register calls are found under the lock until enough of them publish a new generation.
+  static void Freeze() {
+    Manager* m = Manager::Global();
+    std::lock_guard<std::mutex> _lg(m->mutex);
+    m->publish();
+  }
+
+  static bool Frozen() {
+    return Manager::Global()->snapshot.load(std::memory_order_acquire) != nullptr;
+  }
+
+  static Type* Get(std::string_view name) {
     Manager* m = Manager::Global();
+    if (const Snapshot* s = m->snapshot.load(std::memory_order_acquire)) {
+      if (Registry* r = s->find(name)) {
+        return r->get();
+      }
+      // a publish between the two loads clears stale, the miss only holds if s is still current
+      if (!m->stale.load(std::memory_order_acquire) && m->snapshot.load(std::memory_order_acquire) == s) {
+        return nullptr;
+      }
+    }
     std::lock_guard<std::mutex> _lg(m->mutex);
     auto it = m->fmap.find(name);
     if (it == m->fmap.end()) {
@@ -85,8 +151,16 @@ public:
 
   static std::vector<std::string> ListNames() {
     Manager* m = Manager::Global();
-    std::lock_guard<std::mutex> _lg(m->mutex);
     std::vector<std::string> keys;
+    const Snapshot* s = m->snapshot.load(std::memory_order_acquire);
+    if (s != nullptr && !m->stale.load(std::memory_order_acquire) && m->snapshot.load(std::memory_order_acquire) == s) {
+      keys.reserve(s->entries.size());
+      for (const auto &kv : s->entries) {
+        keys.emplace_back(kv.first);
+      }
+      return keys;
+    }
+    std::lock_guard<std::mutex> _lg(m->mutex);
     keys.reserve(m->fmap.size());
     for (const auto &kv : m->fmap) {
       keys.push_back(kv.first);
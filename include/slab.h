@@ -0,0 +1,107 @@
+#pragma once
+
+#include "base.h"
+
+namespace ctypes {
+
+// Per-thread pool of fixed-size slots for T. New takes a slot from the calling thread's slab,
+// Delete may run on any thread and gives the slot back to the slab it came from.
+// A slab outlives its thread until every slot is released.
+template <typename T>
+struct Slab {
+  static constexpr size_t kChunkSize = 64;
+
+  struct Slot {
+    alignas(T) unsigned char storage[sizeof(T)];
+    Slot* next;
+    Slab* owner;
+  };
+
+  struct Stats {
+    size_t live;
+    size_t capacity;
+  };
+
+  template <typename... Args>
+  static T* New(Args&&... args) {
+    Slab* slab = Local();
+    Slot* slot = nullptr;
+    {
+      std::lock_guard<std::mutex> _lg(slab->mutex);
+      if (slab->free_ == nullptr) {
+        slab->grow();
+      }
+      slot = slab->free_;
+      slab->free_ = slot->next;
+      slab->live++;
+    }
+    return new (slot->storage) T(std::forward<Args>(args)...);
+  }
+
+  static void Delete(T* p) {
+    if (p == nullptr) {
+      return;
+    }
+    p->~T();
+    Slot* slot = reinterpret_cast<Slot*>(p);
+    Slab* slab = slot->owner;
+    bool drop = false;
+    {
+      std::lock_guard<std::mutex> _lg(slab->mutex);
+      slot->next = slab->free_;
+      slab->free_ = slot;
+      slab->live--;
+      drop = slab->orphaned && slab->live == 0;
+    }
+    if (drop) {
+      delete slab;
+    }
+  }
+
+  // slots held by the calling thread's slab
+  static Stats LocalStats() {
+    Slab* slab = Local();
+    std::lock_guard<std::mutex> _lg(slab->mutex);
+    return Stats{slab->live, slab->chunks.size() * kChunkSize};
+  }
+
+private:
+  struct Holder {
+    Slab* slab = new Slab;
+    ~Holder() {
+      bool drop = false;
+      {
+        std::lock_guard<std::mutex> _lg(slab->mutex);
+        slab->orphaned = true;
+        drop = slab->live == 0;
+      }
+      if (drop) {
+        delete slab;
+      }
+    }
+  };
+
+  static Slab* Local() {
+    static thread_local Holder holder;
+    return holder.slab;
+  }
+
+  // should hold mutex
+  void grow() {
+    chunks.emplace_back(new Slot[kChunkSize]);
+    Slot* chunk = chunks.back().get();
+    for (size_t i = 0; i < kChunkSize; i++) {
+      chunk[i].owner = this;
+      chunk[i].next = i + 1 < kChunkSize ? &chunk[i + 1] : free_;
+    }
+    free_ = chunk;
+  }
+
+  std::mutex mutex;
+  Slot* free_ = nullptr;
+  std::vector<std::unique_ptr<Slot[]>> chunks;
+  size_t live = 0;
+  bool orphaned = false;
+};
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include "base.h"
+
+// Per-function counters of registered PackedFuncs, build with -DCTI_ENABLE_STATS=0 to leave them out.
+#ifndef CTI_ENABLE_STATS
+#define CTI_ENABLE_STATS 1
+#endif
+
+namespace ctypes {
+
+// Counters of one registered function, updated with relaxed atomics from any thread.
+// Calls are only counted while Enabled(), as reading the clock twice costs more than a small call.
+struct FuncStats {
+  // bucket i counts calls taking [2^i, 2^(i+1)) ns, the last one everything longer
+  static constexpr size_t kBuckets = 32;
+
+  struct Snapshot {
+    uint64_t calls = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    uint64_t ret_bytes = 0;
+    std::array<uint64_t, kBuckets> histogram{};
+  };
+
+  static bool Enabled() {
+    return Flag().load(std::memory_order_relaxed);
+  }
+
+  static void Enable(bool enable) {
+    Flag().store(enable, std::memory_order_relaxed);
+  }
+
+  static uint64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  static size_t Bucket(uint64_t ns) {
+#if defined(__GNUC__)
+    const size_t i = ns == 0 ? 0 : 63 - __builtin_clzll(ns);
+#else
+    size_t i = 0;
+    for (uint64_t n = ns; n > 1; n >>= 1) {
+      i++;
+    }
+#endif
+    return std::min(i, kBuckets - 1);
+  }
+
+  void record(uint64_t ns, uint64_t ret_bytes) {
+    calls_.fetch_add(1, std::memory_order_relaxed);
+    total_ns_.fetch_add(ns, std::memory_order_relaxed);
+    ret_bytes_.fetch_add(ret_bytes, std::memory_order_relaxed);
+    histogram_[Bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t max = max_ns_.load(std::memory_order_relaxed);
+    while (ns > max && !max_ns_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) { }
+  }
+
+  // counters are read one by one, calls running meanwhile may be seen partly
+  Snapshot snapshot() const {
+    Snapshot s;
+    s.calls = calls_.load(std::memory_order_relaxed);
+    s.total_ns = total_ns_.load(std::memory_order_relaxed);
+    s.max_ns = max_ns_.load(std::memory_order_relaxed);
+    s.ret_bytes = ret_bytes_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kBuckets; i++) {
+      s.histogram[i] = histogram_[i].load(std::memory_order_relaxed);
+    }
+    return s;
+  }
+
+  void reset() {
+    calls_.store(0, std::memory_order_relaxed);
+    total_ns_.store(0, std::memory_order_relaxed);
+    max_ns_.store(0, std::memory_order_relaxed);
+    ret_bytes_.store(0, std::memory_order_relaxed);
+    for (auto& i : histogram_) {
+      i.store(0, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  static std::atomic<bool>& Flag() {
+    static std::atomic<bool> flag{false};
+    return flag;
+  }
+
+  std::atomic<uint64_t> calls_{0};
+  std::atomic<uint64_t> total_ns_{0};
+  std::atomic<uint64_t> max_ns_{0};
+  std::atomic<uint64_t> ret_bytes_{0};
+  std::array<std::atomic<uint64_t>, kBuckets> histogram_{};
+};
+
+}
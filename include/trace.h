@@ -0,0 +1,65 @@
+#pragma once
+
+#include "stats.h"
+
+// Spans of PackedFunc calls in Chrome trace-event format, build with -DCTI_ENABLE_TRACE=0 to leave them out.
+#ifndef CTI_ENABLE_TRACE
+#define CTI_ENABLE_TRACE 1
+#endif
+
+namespace ctypes {
+
+// Each thread appends complete ("X") events to a buffer of its own, the dump reads what is published.
+// Starting again drops the events of the previous session.
+struct Trace {
+  // type codes kept per event, later arguments are only counted
+  static constexpr size_t kMaxArgs = 6;
+  static constexpr size_t kDefaultCapacity = 1 << 16;
+
+  struct Event {
+    uint64_t begin_ns;
+    uint64_t end_ns;
+    const char* name;
+    uint32_t num_args;
+    unsigned type_codes[kMaxArgs];
+  };
+
+  // Records one span for the scope it lives in, nothing unless tracing is on when it is created.
+  struct Span {
+    Span(const char* name, size_t num_args, const unsigned* type_codes)
+        : begin_ns(Enabled() ? FuncStats::Now() : 0), name(name), num_args(num_args), type_codes(type_codes) { }
+    Span(const Span&) = delete;
+    ~Span() {
+      if (begin_ns != 0) {
+        Record(*this);
+      }
+    }
+
+    uint64_t begin_ns;
+    const char* name;
+    size_t num_args;
+    const unsigned* type_codes;
+  };
+
+  static bool Enabled() {
+    return Flag().load(std::memory_order_relaxed);
+  }
+
+  // capacity is the number of events kept per thread, 0 picks kDefaultCapacity
+  static void Start(size_t capacity = 0);
+  static void Stop();
+  // Writes the events of the current session as trace JSON, false if path could not be written.
+  static bool Dump(const std::string& path);
+  // events not recorded because their thread's buffer was full
+  static uint64_t Dropped();
+
+private:
+  static std::atomic<bool>& Flag() {
+    static std::atomic<bool> flag{false};
+    return flag;
+  }
+
+  static void Record(const Span& span);
+};
+
+}
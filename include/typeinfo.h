@@ -0,0 +1,90 @@
+#pragma once
+
+#include "packedfunc.h"
+
+namespace ctypes {
+
+// What the bindings need to know about a type code: its name, the size of the value v_voidp
+// points to (0 if the value is stored inline) and how to copy or free such a value.
+struct TypeInfo {
+  using Copy = void* (*)(const void*);
+  using Free = void (*)(void*);
+
+  // codes are indexed by a flat table, so they should stay small
+  static constexpr PackedType kMaxCode = 256;
+
+  enum Flags : unsigned {
+    kRefcounted = 1,
+  };
+
+  PackedType code = PackedTypeCode::kUnknown;
+  std::string name;
+  size_t size = 0;
+  unsigned flags = 0;
+  Copy copy = nullptr;
+  Free free = nullptr;
+
+  // constant time lookup, nullptr if nothing is registered for code
+  static const TypeInfo* Get(PackedType code) {
+    return code < kMaxCode ? Table()[code].load(std::memory_order_acquire) : nullptr;
+  }
+
+  static std::array<std::atomic<const TypeInfo*>, kMaxCode>& Table() {
+    static std::array<std::atomic<const TypeInfo*>, kMaxCode> table{};
+    return table;
+  }
+};
+
+template<>
+struct _Registry<TypeInfo> : public _Registry_Base<TypeInfo> {
+public:
+  using Type = TypeInfo;
+  using typename _Registry_Base<Type>::RegistryType;
+protected:
+  Type content_;
+  _Registry() = default;
+public:
+  // Indexes the entry by code, each code may be registered once.
+  RegistryType& set_code(PackedType code, size_t size = 0) {
+    RegistryType* self = dynamic_cast<RegistryType*>(this);
+    content_.code = code;
+    content_.name = self->name();
+    content_.size = size;
+    if (code >= TypeInfo::kMaxCode) {
+      FATAL() << "type code " << code << " of " << content_.name << " is too large";
+      return *self;
+    }
+    const TypeInfo* expected = nullptr;
+    if (!TypeInfo::Table()[code].compare_exchange_strong(expected, &content_, std::memory_order_acq_rel)) {
+      FATAL() << "type code " << code << " of " << content_.name << " is already registered by " << expected->name;
+    }
+    return *self;
+  }
+
+  // An ext type T, copied with its copy constructor or shared if it derives Object.
+  template <typename T>
+  RegistryType& set_type() {
+    static_assert(PackedTypeCode::is_ext_type<T>::value);
+    if constexpr (std::is_base_of<Object, T>::value) {
+      content_.flags |= TypeInfo::kRefcounted;
+      content_.copy = [](const void* p) -> void* {
+        T* obj = const_cast<T*>(static_cast<const T*>(p));
+        obj->IncRef();
+        return obj;
+      };
+      content_.free = [](void* p) { static_cast<T*>(p)->DecRef(); };
+    } else {
+      content_.copy = [](const void* p) -> void* { return new T(*static_cast<const T*>(p)); };
+      content_.free = [](void* p) { delete static_cast<T*>(p); };
+    }
+    return set_code(PackedTypeCode::TypeCode<T>::code(), sizeof(T));
+  }
+
+  Type* get() override {
+    return &content_;
+  }
+};
+
+template <> const std::string Registry<TypeInfo>::RegistryName_;
+
+}
@@ -1,15 +1,54 @@
 #!python3
 
 from __future__ import absolute_import, division, print_function, unicode_literals
+import array
 import ctypes
+import itertools
 import os
+import sys
+import threading
+import traceback
 import types
 
 """
 CTI_EXPORT int CTIRegistryListNames(const char* tag, OUT int* ret_size, OUT const char*** ret_names);
+CTI_EXPORT int CTIRegistryFreeze(const char* tag);
 CTI_EXPORT int CTIRegistryGet(const char* tag, const char* name, OUT func_handle* ret_handle);
+CTI_EXPORT int CTIRegistryStatsEnable(int enable);
+CTI_EXPORT int CTIRegistryStats(const char* tag, const char* name, OUT funcstats_handle* ret_stats);
+CTI_EXPORT int CTIRegistryStatsReset(const char* tag, const char* name);
 CTI_EXPORT int CTIPackedFuncCall(const void* handle, int num_args, const unsigned* type_codes, const packedvalue_handle* values,
                                  OUT unsigned* ret_type, OUT packedvalue_handle* ret_val);
+CTI_EXPORT int CTIPackedFuncCallOwned(const void* handle, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
+                                      OUT retvalue_handle* ret_handle, OUT unsigned* ret_type, OUT packedvalue_handle* ret_val);
+CTI_EXPORT int CTIRetValueRelease(retvalue_handle handle);
+CTI_EXPORT int CTICompletionQueueCreate(OUT completionqueue_handle* ret_queue);
+CTI_EXPORT int CTICompletionQueueFree(completionqueue_handle queue);
+CTI_EXPORT int CTIPackedFuncCallAsync(const void* handle, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
+                                      completionqueue_handle queue, OUT uint64_t* ret_ticket);
+CTI_EXPORT int CTICompletionQueueWait(completionqueue_handle queue, int64_t timeout_ms, OUT int* ret_ready, OUT uint64_t* ret_ticket,
+                                      OUT retvalue_handle* ret_handle, OUT unsigned* ret_type, OUT packedvalue_handle* ret_val);
+CTI_EXPORT int CTIParallelGetStats(OUT size_t* ret_num_threads, OUT uint64_t* ret_calls, OUT uint64_t* ret_tasks, OUT uint64_t* ret_steals);
+CTI_EXPORT int CTIStreamNext(stream_handle stream, OUT int* ret_has_next, OUT unsigned* ret_type, OUT packedvalue_handle* ret_val);
+CTI_EXPORT int CTIStreamClose(stream_handle stream);
+CTI_EXPORT int CTIPackedFuncCallBatch(const void* handle, size_t num_calls, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
+                                      OUT unsigned* ret_types, OUT packedvalue_handle* ret_vals);
+CTI_EXPORT int CTIPackedFuncCreate(packedcallback_handle callback, void* resource, packedfinalizer_handle finalizer, OUT func_handle* ret_handle);
+CTI_EXPORT int CTIPackedFuncFree(func_handle handle);
+CTI_EXPORT int CTIArenaGetStats(OUT size_t* ret_used, OUT size_t* ret_reserved, OUT size_t* ret_high_water,
+                                OUT uint64_t* ret_resets, OUT uint64_t* ret_allocations, OUT uint64_t* ret_oversized);
+CTI_EXPORT int CTIArenaSetChunkSize(size_t chunk_size);
+CTI_EXPORT int CTITraceStart(size_t events_per_thread);
+CTI_EXPORT int CTITraceStop();
+CTI_EXPORT int CTITraceDump(const char* path, OUT uint64_t* ret_dropped);
+CTI_EXPORT int CTIMappedFileOpen(const char* path, packeddtype_handle dtype, OUT mappedfile_handle* ret_handle);
+CTI_EXPORT int CTIMappedFileRelease(mappedfile_handle handle);
+CTI_EXPORT int CTIObjectRetain(object_handle handle);
+CTI_EXPORT int CTIObjectRelease(object_handle handle);
+CTI_EXPORT int CTITypeList(OUT size_t* ret_size, OUT const unsigned** ret_codes, OUT const char*** ret_names);
+CTI_EXPORT int CTITypeGetInfo(unsigned type_code, OUT const char** ret_name, OUT size_t* ret_size, OUT unsigned* ret_flags);
+CTI_EXPORT int CTITypeCopy(unsigned type_code, void* value, OUT void** ret_value);
+CTI_EXPORT int CTITypeFree(unsigned type_code, void* value);
 """
 
 
@@ -23,6 +62,11 @@ class classproperty(object):
 
 packedtypecode = ctypes.c_uint
 packedfunc_handle = ctypes.c_void_p
+retvalue_handle = ctypes.c_void_p
+completionqueue_handle = ctypes.c_void_p
+stream_handle = ctypes.c_void_p
+mappedfile_handle = ctypes.c_void_p
+object_handle = ctypes.c_void_p
 
 
 class packedvec_handle(ctypes.Structure):
@@ -62,11 +106,348 @@ packedvec_handle._fields_ = [
 ]
 
 
+class packeddtype_handle(ctypes.Structure):
+    _fields_ = [("code", ctypes.c_uint8),
+                ("bits", ctypes.c_uint8),
+                ("lanes", ctypes.c_uint16)]
+
+
+class packedtensor_handle(ctypes.Structure):
+    """
+    struct PackedTensor {
+      void* data;
+      PackedDType dtype;
+      int32_t ndim;
+      const int64_t* shape;
+      const int64_t* strides;
+    };
+    """
+    _fields_ = [("data", ctypes.c_void_p),
+                ("dtype", packeddtype_handle),
+                ("ndim", ctypes.c_int32),
+                ("shape", ctypes.POINTER(ctypes.c_int64)),
+                ("strides", ctypes.POINTER(ctypes.c_int64))]
+
+
+class Tensor:
+    """
+    Dense buffer passed as kTensor without copying, data is an array.array or a ctypes array.
+    strides count elements, None means compact row-major.
+    """
+    # (code, bits) of PackedDType for array.array typecodes
+    dtypes = {
+        "b": (0, 8), "h": (0, 16), "i": (0, 32), "l": (0, ctypes.sizeof(ctypes.c_long) * 8), "q": (0, 64),
+        "B": (1, 8), "H": (1, 16), "I": (1, 32), "L": (1, ctypes.sizeof(ctypes.c_ulong) * 8), "Q": (1, 64),
+        "f": (2, 32), "d": (2, 64),
+    }
+
+    def __init__(self, data, shape=None, strides=None):
+        if isinstance(data, array.array):
+            typecode = data.typecode
+        elif isinstance(data, ctypes.Array):
+            typecode = data._type_._type_
+        else:
+            raise ValueError("Tensor data should be array.array or ctypes array")
+        if typecode not in Tensor.dtypes:
+            raise ValueError("unsupported element type %s" % typecode)
+        self.data = data
+        self.typecode = typecode
+        self.shape = tuple(shape) if shape is not None else (len(data),)
+        self.strides = tuple(strides) if strides is not None else None
+
+    @staticmethod
+    def from_(value):
+        handle = packedtensor_handle()
+        if isinstance(value.data, array.array):
+            handle.data = value.data.buffer_info()[0]
+        else:
+            handle.data = ctypes.addressof(value.data)
+        code, bits = Tensor.dtypes[value.typecode]
+        handle.dtype = packeddtype_handle(code, bits, 1)
+        handle.ndim = len(value.shape)
+        handle.shape = (ctypes.c_int64 * len(value.shape))(*value.shape)
+        if value.strides is not None:
+            handle.strides = (ctypes.c_int64 * len(value.strides))(*value.strides)
+        packed_value = packedvalue_handle()
+        packed_value.v_void_p = ctypes.addressof(handle)
+        # the handle should live as long as the packed value
+        packed_value._tensor = (handle, value)
+        return "kTensor", packed_value
+
+    @staticmethod
+    def copy_from(handle):
+        """Copy a native tensor into a compact Tensor backed by array.array."""
+        dtype = (handle.dtype.code, handle.dtype.bits)
+        typecode = [k for k, v in Tensor.dtypes.items() if v == dtype and k not in "lL"]
+        if handle.dtype.lanes != 1 or not typecode:
+            raise ValueError("unsupported dtype (%d, %d, %d)" % (dtype + (handle.dtype.lanes,)))
+        shape = [handle.shape[i] for i in range(handle.ndim)]
+        size = 1
+        for i in shape:
+            size *= i
+        data = array.array(typecode[0], bytes(size * handle.dtype.bits // 8))
+        if size == 0:
+            pass
+        elif not handle.strides:
+            ctypes.memmove(data.buffer_info()[0], handle.data, size * data.itemsize)
+        else:
+            src = ctypes.cast(handle.data, ctypes.POINTER(ctypes.c_char))
+            for i in range(size):
+                offset, rest = 0, i
+                for d in reversed(range(handle.ndim)):
+                    offset += (rest % shape[d]) * handle.strides[d]
+                    rest //= shape[d]
+                data[i] = array.array(typecode[0], src[offset * data.itemsize:(offset + 1) * data.itemsize])[0]
+        return Tensor(data, shape)
+
+    def tolist(self):
+        if self.strides is not None:
+            raise ValueError("tolist only supports compact tensors")
+        flat = list(self.data)
+        for d in reversed(self.shape[1:]):
+            flat = [flat[i:i + d] for i in range(0, len(flat), d)]
+        return flat
+
+    def __repr__(self):
+        return "<Tensor %s %s>" % (self.typecode, self.shape)
+
+
+class packedbytes_handle(ctypes.Structure):
+    _fields_ = [("data", ctypes.c_void_p),
+                ("size", ctypes.c_size_t)]
+
+
+class funcstats_handle(ctypes.Structure):
+    BUCKETS = 32
+    _fields_ = [("calls", ctypes.c_uint64),
+                ("total_ns", ctypes.c_uint64),
+                ("max_ns", ctypes.c_uint64),
+                ("ret_bytes", ctypes.c_uint64),
+                ("histogram", ctypes.c_uint64 * BUCKETS)]
+
+
+class Py_buffer(ctypes.Structure):
+    _fields_ = [("buf", ctypes.c_void_p),
+                ("obj", ctypes.py_object),
+                ("len", ctypes.c_ssize_t),
+                ("itemsize", ctypes.c_ssize_t),
+                ("readonly", ctypes.c_int),
+                ("ndim", ctypes.c_int),
+                ("format", ctypes.c_char_p),
+                ("shape", ctypes.POINTER(ctypes.c_ssize_t)),
+                ("strides", ctypes.POINTER(ctypes.c_ssize_t)),
+                ("suboffsets", ctypes.POINTER(ctypes.c_ssize_t)),
+                ("internal", ctypes.c_void_p)]
+
+
+ctypes.pythonapi.PyObject_GetBuffer.argtypes = [ctypes.py_object, ctypes.POINTER(Py_buffer), ctypes.c_int]
+ctypes.pythonapi.PyObject_GetBuffer.restype = ctypes.c_int
+ctypes.pythonapi.PyBuffer_Release.argtypes = [ctypes.POINTER(Py_buffer)]
+ctypes.pythonapi.PyBuffer_Release.restype = None
+
+
+class Buffer:
+    """Holds an exported buffer of obj, which stays pinned until release()."""
+    PyBUF_SIMPLE = 0
+    # PyBUF_STRIDES | PyBUF_FORMAT, read-only exporters are accepted
+    PyBUF_RECORDS_RO = 0x1c
+
+    def __init__(self, obj, flags=PyBUF_SIMPLE):
+        self.view = Py_buffer()
+        ctypes.pythonapi.PyObject_GetBuffer(obj, ctypes.byref(self.view), flags)
+        self.held = True
+
+    def release(self):
+        if self.held:
+            ctypes.pythonapi.PyBuffer_Release(ctypes.byref(self.view))
+            self.held = False
+
+    def __del__(self):
+        self.release()
+
+
+def bytes_from_(value):
+    """Pass bytes, bytearray or a contiguous memoryview as kBytes without copying."""
+    buffer = Buffer(value)
+    handle = packedbytes_handle(buffer.view.buf, buffer.view.len)
+    packed_value = packedvalue_handle()
+    packed_value.v_void_p = ctypes.addressof(handle)
+    packed_value._bytes = (handle, buffer)
+    return "kBytes", packed_value
+
+
+def tensor_from_buffer_(value):
+    """
+    Pass any object exporting a typed buffer (array.array, memoryview, numpy.ndarray, ...) as kTensor
+    without copying, the exporter stays pinned as long as the packed value.
+    """
+    buffer = Buffer(value, Buffer.PyBUF_RECORDS_RO)
+    view = buffer.view
+    typecode = view.format.decode() if view.format else "B"
+    if typecode[:1] in ("@", "=", "<" if sys.byteorder == "little" else ">"):
+        typecode = typecode[1:]
+    if typecode not in Tensor.dtypes:
+        raise ValueError("unsupported buffer format %s" % view.format)
+    # the size of l and L follows the platform, so bits come from itemsize
+    code = Tensor.dtypes[typecode][0]
+    handle = packedtensor_handle()
+    handle.data = view.buf
+    handle.dtype = packeddtype_handle(code, view.itemsize * 8, 1)
+    handle.ndim = max(view.ndim, 1)
+    shape = [view.shape[i] for i in range(view.ndim)] if view.ndim else [view.len // view.itemsize]
+    handle.shape = (ctypes.c_int64 * len(shape))(*shape)
+    if view.strides and view.ndim:
+        strides = [view.strides[i] for i in range(view.ndim)]
+        if any(x % view.itemsize for x in strides):
+            raise ValueError("buffer strides should be multiples of the item size")
+        strides = [x // view.itemsize for x in strides]
+        compact, size = [], 1
+        for d in reversed(shape):
+            compact.insert(0, size)
+            size *= d
+        if strides != compact:
+            handle.strides = (ctypes.c_int64 * len(strides))(*strides)
+    packed_value = packedvalue_handle()
+    packed_value.v_void_p = ctypes.addressof(handle)
+    packed_value._tensor = (handle, buffer)
+    return "kTensor", packed_value
+
+
+def memoryview_from_(value):
+    """Byte views are passed as kBytes, typed or multi-dimensional views as kTensor."""
+    if value.format in ("B", "b", "c") and value.ndim <= 1 and value.c_contiguous:
+        return bytes_from_(value)
+    return tensor_from_buffer_(value)
+
+
+class packedragged_handle(ctypes.Structure):
+    """
+    struct PackedRagged {
+      PackedValue* values;
+      const int64_t* offsets;
+      size_t num_rows;
+      PackedType type_code;
+    };
+    """
+    _fields_ = [("values", ctypes.POINTER(packedvalue_handle)),
+                ("offsets", ctypes.POINTER(ctypes.c_int64)),
+                ("num_rows", ctypes.c_size_t),
+                ("type_code", packedtypecode)]
+
+
+class Ragged:
+    """Rows of varying length packed into one values buffer and an offsets array, passed as kRagged."""
+
+    def __init__(self, rows):
+        self.rows = rows
+        size = sum(len(row) for row in rows)
+        self.values = (packedvalue_handle * size)()
+        self.offsets = (ctypes.c_int64 * (len(rows) + 1))()
+        type_code, i = None, 0
+        for r, row in enumerate(rows):
+            for x in row:
+                tp, v = PackedArg.from_(x)
+                if type_code is None:
+                    type_code = tp
+                elif type_code != tp:
+                    raise ValueError("Type code not consistent in ragged")
+                if isinstance(tp, tuple) or tp == "kVector":
+                    raise ValueError("Ragged rows should hold scalars")
+                self.values[i] = v
+                i += 1
+            self.offsets[r + 1] = i
+        self.type_code = PackedArg.from_typecode(type_code)
+
+    @staticmethod
+    def from_(value):
+        handle = packedragged_handle()
+        handle.values = value.values
+        handle.offsets = value.offsets
+        handle.num_rows = len(value.rows)
+        handle.type_code = value.type_code
+        packed_value = packedvalue_handle()
+        packed_value.v_void_p = ctypes.addressof(handle)
+        packed_value._ragged = (handle, value)
+        return "kRagged", packed_value
+
+    @staticmethod
+    def to_lists(lib, handle):
+        return [[PackedArg(lib, handle.values[j], type_code=handle.type_code).to()
+                 for j in range(handle.offsets[i], handle.offsets[i + 1])]
+                for i in range(handle.num_rows)]
+
+    def __len__(self):
+        return len(self.rows)
+
+    def __repr__(self):
+        return "<Ragged %d rows>" % len(self.rows)
+
+
+class MappedFile:
+    """
+    Read-only mapping of a file as a 1-d tensor, passed as kMappedFile without copying.
+    Functions taking a kTensor accept it as well. Unmapped by close or when collected.
+    """
+
+    def __init__(self, lib, handle):
+        self.lib = lib
+        self.handle = handle
+
+    @staticmethod
+    def open(lib, path, typecode="B"):
+        code, bits = Tensor.dtypes[typecode]
+        handle = mappedfile_handle()
+        if lib.lib.CTIMappedFileOpen(path.encode(), packeddtype_handle(code, bits, 1), ctypes.byref(handle)) != 0:
+            raise OSError("could not map %s" % path)
+        return MappedFile(lib, handle.value)
+
+    @staticmethod
+    def from_(value):
+        if value.handle is None:
+            raise ValueError("MappedFile is closed")
+        packed_value = packedvalue_handle()
+        packed_value.v_void_p = value.handle
+        return "kMappedFile", packed_value
+
+    @property
+    def tensor(self):
+        return ctypes.cast(self.handle, ctypes.POINTER(packedtensor_handle)).contents
+
+    def __len__(self):
+        return self.tensor.shape[0]
+
+    def tobytes(self):
+        t = self.tensor
+        return ctypes.string_at(t.data, t.shape[0] * t.dtype.bits // 8) if t.shape[0] else b""
+
+    def close(self):
+        if self.handle is not None:
+            self.lib.lib.CTIMappedFileRelease(self.handle)
+            self.handle = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def __del__(self):
+        self.close()
+
+    def __repr__(self):
+        return "<MappedFile %d>" % (len(self) if self.handle is not None else -1)
+
+
 class ExtBaseCls:
+    # set when the native type derives ctypes::Object, every wrapper then holds a reference of its own
+    refcounted = False
+
     def __init__(self, lib, handle):
         self.lib = lib
         self.handle = handle
         self.is_py = False
+        if self.refcounted and handle:
+            lib.lib.CTIObjectRetain(handle)
 
     @classmethod
     def from_(cls, value):
@@ -98,7 +479,11 @@ class ExtBaseCls:
         return t
 
     def release(self):
-        if self.is_py:
+        if self.refcounted:
+            if self.handle:
+                self.lib.lib.CTIObjectRelease(self.handle)
+                self.handle = None
+        elif self.is_py:
             self._release()
 
     def __del__(self):
@@ -118,6 +503,11 @@ class PackedArg:
       kStr = 4,
       kFunc = 5,
       kVector = 6,
+      kStream = 7,
+      kTensor = 8,
+      kRagged = 9,
+      kBytes = 10,
+      kMappedFile = 11,
     };
     """
     type_codes = {
@@ -128,8 +518,19 @@ class PackedArg:
         "kStr": 4,
         "kFunc": 5,
         "kVector": 6,
+        "kStream": 7,
+        "kTensor": 8,
+        "kRagged": 9,
+        "kBytes": 10,
+        "kMappedFile": 11,
     }
     ext_klass = {}
+    # converters of native values indexed by type code, rebuilt from the native type list by LoadTypes
+    to_table = []
+    # ctypes of vector elements that are read as a whole
+    _vector_ctypes = {}
+    # converters of python values by exact type, subclasses are resolved once and cached
+    from_table = {}
 
     def __init__(self, lib, value, type_code=None):
         if type_code is None:
@@ -137,7 +538,7 @@ class PackedArg:
             type_code = PackedArg.from_typecode(tp)
         elif not isinstance(value, packedvalue_handle):
             raise ValueError("value should be packedvalue_handle")
-        elif type_code not in PackedArg.type_codes.values():
+        elif type_code >= len(PackedArg.to_table) or PackedArg.to_table[type_code] is None:
             raise ValueError("type_code %s invalid" % type_code)
         self.lib = lib
         self.type_code = type_code
@@ -145,51 +546,129 @@ class PackedArg:
 
     @staticmethod
     def from_(value):
+        convert = PackedArg.from_table.get(type(value))
+        if convert is None:
+            convert = PackedArg._resolve_from(type(value), value)
+        return convert(value)
+
+    @staticmethod
+    def _resolve_from(tp, value=None):
+        bases = PackedArg._from_bases() + [(ext_cls, ext_cls.from_) for _, ext_cls in sorted(PackedArg.ext_klass.items())]
+        for base, convert in bases:
+            if issubclass(tp, base):
+                PackedArg.from_table[tp] = convert
+                return convert
+        # other exporters of the buffer protocol, such as numpy arrays, could only be told by an instance
+        try:
+            memoryview(value).release()
+        except TypeError:
+            raise ValueError("unknown type of value")
+        PackedArg.from_table[tp] = tensor_from_buffer_
+        return tensor_from_buffer_
+
+    @staticmethod
+    def _from_bases():
+        return [
+            (int, PackedArg._from_int64),
+            (float, PackedArg._from_float64),
+            (str, PackedArg._from_str),
+            (PackedFunc, PackedArg._from_func),
+            ((bytes, bytearray), bytes_from_),
+            (memoryview, memoryview_from_),
+            (array.array, tensor_from_buffer_),
+            (Tensor, Tensor.from_),
+            (Ragged, Ragged.from_),
+            (MappedFile, MappedFile.from_),
+            (list, PackedArg._from_list),
+        ]
+
+    @staticmethod
+    def _from_int64(value):
         packed_value = packedvalue_handle()
-        if isinstance(value, int):
-            packed_value.v_int64 = value
-            return "kInt64", packed_value
-        elif isinstance(value, float):
-            packed_value.v_float64 = value
-            return "kFloat64", packed_value
-        elif isinstance(value, str):
-            packed_value.v_str = value.encode()
-            return "kStr", packed_value
-        elif isinstance(value, PackedFunc):
-            packed_value.v_func = value.func_handle
-            return "kFunc", packed_value
-        elif isinstance(value, list):
-            tp, vec = PackedArg.make_vec(value)
-            packed_value.v_vec = ctypes.pointer(vec)
-            return tp, packed_value
-        else:
-            for _, ext_cls in sorted(PackedArg.ext_klass.items()):
-                if isinstance(value, ext_cls):
-                    return ext_cls.from_(value)
-        raise ValueError("unknown type of value")
+        packed_value.v_int64 = value
+        return "kInt64", packed_value
+
+    @staticmethod
+    def _from_float64(value):
+        packed_value = packedvalue_handle()
+        packed_value.v_float64 = value
+        return "kFloat64", packed_value
+
+    @staticmethod
+    def _from_str(value):
+        packed_value = packedvalue_handle()
+        packed_value.v_str = value.encode()
+        return "kStr", packed_value
+
+    @staticmethod
+    def _from_func(value):
+        packed_value = packedvalue_handle()
+        packed_value.v_func = value.func_handle
+        return "kFunc", packed_value
+
+    @staticmethod
+    def _from_list(value):
+        packed_value = packedvalue_handle()
+        tp, vec = PackedArg.make_vec(value)
+        packed_value.v_vec = ctypes.pointer(vec)
+        return tp, packed_value
 
     def to(self):
-        type_code = self.type_code
-        if type_code == PackedArg.type_codes["kUnknown"]:
-            raise ValueError("Unknown type_code")
-        elif type_code == PackedArg.type_codes["kInt64"]:
-            return self.value.v_int64
-        elif type_code == PackedArg.type_codes["kFloat64"]:
-            return self.value.v_float64
-        elif type_code == PackedArg.type_codes["kStr"]:
-            return self.value.v_str.decode()
-        elif type_code == PackedArg.type_codes["kFunc"]:
-            return PackedFunc(self.lib, self.value.v_func)
-        elif type_code == PackedArg.type_codes["kVector"]:
-            ret = []
-            vec = self.value.v_vec.contents
-            for i in range(vec.count):
-                ret.append(PackedArg(self.lib, vec.data[i], type_code=vec.type_code).to())
-            return ret
-        else:
-            for _, ext_cls in sorted(PackedArg.ext_klass.items()):
-                if type_code == ext_cls.type_code:
-                    return ext_cls(self.lib, self.value.v_void_p)
+        return PackedArg.to_table[self.type_code](self)
+
+    def _to_unknown(self):
+        raise ValueError("Unknown type_code")
+
+    def _to_vector(self):
+        vec = self.value.v_vec.contents
+        # numeric elements are read in one go, their values are laid out as int64_t or double
+        element = PackedArg._vector_ctypes.get(vec.type_code)
+        if element is not None and vec.count:
+            return (element * vec.count).from_address(ctypes.addressof(vec.data.contents))[:]
+        return [PackedArg(self.lib, vec.data[i], type_code=vec.type_code).to() for i in range(vec.count)]
+
+    _to_by_name = {
+        "kUnknown": _to_unknown,
+        "kInt64": lambda self: self.value.v_int64,
+        "kFloat64": lambda self: self.value.v_float64,
+        "kPtr": lambda self: self.value.v_void_p,
+        "kStr": lambda self: self.value.v_str.decode(),
+        "kFunc": lambda self: PackedFunc(self.lib, self.value.v_func),
+        "kVector": _to_vector,
+        "kStream": lambda self: PackedStream(self.lib, self.value.v_void_p),
+        "kTensor": lambda self: Tensor.copy_from(ctypes.cast(self.value.v_void_p, ctypes.POINTER(packedtensor_handle)).contents),
+        "kBytes": lambda self: ctypes.string_at(*PackedArg._bytes_of(self.value.v_void_p)),
+        "kRagged": lambda self: Ragged.to_lists(self.lib, ctypes.cast(self.value.v_void_p, ctypes.POINTER(packedragged_handle)).contents),
+        # the caller owns a returned mapping
+        "kMappedFile": lambda self: MappedFile(self.lib, self.value.v_void_p) if self.value.v_void_p else None,
+    }
+
+    @staticmethod
+    def _bytes_of(handle):
+        value = ctypes.cast(handle, ctypes.POINTER(packedbytes_handle)).contents
+        return value.data, value.size
+
+    @staticmethod
+    def LoadTypes(types):
+        """Index converters by the codes the native library reports, types is a list of (code, name)."""
+        for code, name in types:
+            if name in PackedArg._to_by_name:
+                PackedArg.type_codes[name] = code
+        PackedArg._build_to_table()
+
+    @staticmethod
+    def _build_to_table():
+        codes = [(code, PackedArg._to_by_name[name]) for name, code in PackedArg.type_codes.items() if name in PackedArg._to_by_name]
+        codes += [(code, PackedArg._to_ext(ext_cls)) for code, ext_cls in PackedArg.ext_klass.items()]
+        table = [None] * (max(code for code, _ in codes) + 1)
+        for code, convert in codes:
+            table[code] = convert
+        PackedArg.to_table = table
+        PackedArg._vector_ctypes = {PackedArg.type_codes["kInt64"]: ctypes.c_int64, PackedArg.type_codes["kFloat64"]: ctypes.c_double}
+
+    @staticmethod
+    def _to_ext(ext_cls):
+        return lambda self: ext_cls(self.lib, self.value.v_void_p)
 
     def __repr__(self):
         return "<PackedArg %d %s>" % (self.type_code, self.to())
@@ -228,6 +707,153 @@ class PackedArg:
             raise ValueError("type_code %d or ext_name %s already registered" % type_code, ext_name)
         cls.type_codes[ext_name] = type_code
         cls.ext_klass[type_code] = ext_cls
+        cls.from_table[ext_cls] = ext_cls.from_
+        cls._build_to_table()
+
+
+PackedArg._build_to_table()
+
+
+class RetValue:
+    """Result of PackedFunc.call_owned, the native value stays valid until release()."""
+
+    def __init__(self, lib, handle, type_code, value):
+        self.lib = lib
+        self.handle = handle
+        self.type_code = type_code
+        self.value = value
+
+    def to(self):
+        if self.handle is None:
+            raise ValueError("RetValue already released")
+        return PackedArg(self.lib, self.value, type_code=self.type_code).to()
+
+    def buffer(self):
+        """
+        A memoryview of the native result without copying: numeric vectors as q or d, compact tensors
+        in their shape and bytes as B. It keeps the RetValue alive, release() should not be called while it is used.
+        """
+        if self.handle is None:
+            raise ValueError("RetValue already released")
+        codes = PackedArg.type_codes
+        if self.type_code == codes["kVector"]:
+            vec = self.value.v_vec.contents
+            element = PackedArg._vector_ctypes.get(vec.type_code)
+            if element is None and vec.count:
+                raise ValueError("only vectors of kInt64 or kFloat64 could be viewed")
+            typecode = "d" if element is ctypes.c_double else "q"
+            return self._view(ctypes.cast(vec.data, ctypes.c_void_p).value, vec.count * 8, typecode, (vec.count,))
+        if self.type_code == codes["kTensor"]:
+            t = ctypes.cast(self.value.v_void_p, ctypes.POINTER(packedtensor_handle)).contents
+            typecode = [k for k, v in Tensor.dtypes.items() if v == (t.dtype.code, t.dtype.bits) and k not in "lL"]
+            if t.dtype.lanes != 1 or not typecode or t.strides:
+                raise ValueError("only compact tensors of array.array types could be viewed")
+            shape = tuple(t.shape[i] for i in range(t.ndim))
+            size = 1
+            for i in shape:
+                size *= i
+            return self._view(t.data, size * t.dtype.bits // 8, typecode[0], shape)
+        if self.type_code == codes["kBytes"]:
+            data, size = PackedArg._bytes_of(self.value.v_void_p)
+            return self._view(data, size, "B", (size,))
+        raise ValueError("type_code %d could not be viewed" % self.type_code)
+
+    def _view(self, address, size, typecode, shape):
+        if size == 0:
+            return memoryview(array.array(typecode))
+        data = (ctypes.c_char * size).from_address(address)
+        data._owner = self
+        return memoryview(data).cast("B").cast(typecode, shape)
+
+    def release(self):
+        if self.handle is not None:
+            self.lib.lib.CTIRetValueRelease(self.handle)
+            self.handle = None
+
+    def __del__(self):
+        self.release()
+
+    def __repr__(self):
+        return "<RetValue %d>" % self.type_code
+
+
+class PackedStream:
+    """Iterator over the chunks of a kStream value, each chunk is converted as it is pulled."""
+
+    def __init__(self, lib, handle):
+        self.lib = lib
+        self.handle = handle
+
+    def __iter__(self):
+        return self
+
+    def __next__(self):
+        if self.handle is None:
+            raise StopIteration
+        has_next = ctypes.c_int()
+        ret_type = packedtypecode()
+        ret_val = packedvalue_handle()
+        self.lib.lib.CTIStreamNext(self.handle, ctypes.byref(has_next), ctypes.byref(ret_type), ctypes.byref(ret_val))
+        if not has_next.value:
+            self.close()
+            raise StopIteration
+        return PackedArg(self.lib, ret_val, type_code=ret_type.value).to()
+
+    def close(self):
+        if self.handle is not None:
+            self.lib.lib.CTIStreamClose(self.handle)
+            self.handle = None
+
+    def __del__(self):
+        self.close()
+
+    def __repr__(self):
+        return "<PackedStream>"
+
+
+class CompletionQueue:
+    """Collects results of PackedFunc.call_async, calls run on the library's worker pool."""
+
+    def __init__(self, lib):
+        self.lib = lib
+        self.handle = completionqueue_handle()
+        lib.lib.CTICompletionQueueCreate(ctypes.byref(self.handle))
+        # arguments must stay alive until their call completes
+        self.pending = {}
+
+    def submit(self, func_handle, *args):
+        packed_args, type_codes, values = self.lib._pack_args(args)
+        ticket = ctypes.c_uint64()
+        self.lib.lib.CTIPackedFuncCallAsync(func_handle, len(args), type_codes, values, self.handle, ctypes.byref(ticket))
+        self.pending[ticket.value] = (packed_args, type_codes, values)
+        return ticket.value
+
+    def wait(self, timeout=None):
+        """Returns (ticket, RetValue) of a completed call, or None after timeout seconds or if no call is pending."""
+        timeout_ms = -1 if timeout is None else int(timeout * 1000)
+        ready = ctypes.c_int()
+        ticket = ctypes.c_uint64()
+        ret_handle = retvalue_handle()
+        ret_type = packedtypecode()
+        ret_val = packedvalue_handle()
+        self.lib.lib.CTICompletionQueueWait(self.handle, timeout_ms, ctypes.byref(ready), ctypes.byref(ticket),
+                                            ctypes.byref(ret_handle), ctypes.byref(ret_type), ctypes.byref(ret_val))
+        if not ready.value:
+            return None
+        self.pending.pop(ticket.value, None)
+        return ticket.value, RetValue(self.lib, ret_handle.value, ret_type.value, ret_val)
+
+    def poll(self):
+        return self.wait(timeout=0)
+
+    def close(self):
+        if self.handle:
+            self.lib.lib.CTICompletionQueueFree(self.handle)
+            self.handle = None
+            self.pending.clear()
+
+    def __del__(self):
+        self.close()
 
 
 class PackedFunc:
@@ -239,16 +865,186 @@ class PackedFunc:
     def __call__(self, *args):
         return self.lib.PackedFuncCall(self.func_handle, *args)
 
+    def call_owned(self, *args):
+        return self.lib.PackedFuncCallOwned(self.func_handle, *args)
+
+    def call_async(self, queue, *args):
+        return queue.submit(self.func_handle, *args)
+
+    def batch(self, rows):
+        return self.lib.PackedFuncCallBatch(self.func_handle, rows)
+
     def __repr__(self):
         return "<PackedFunc %s>" % self.name
 
 
+packedcallback_handle = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(packedtypecode),
+                                         ctypes.POINTER(packedvalue_handle), ctypes.POINTER(packedtypecode),
+                                         ctypes.POINTER(packedvalue_handle))
+packedfinalizer_handle = ctypes.CFUNCTYPE(None, ctypes.c_void_p)
+
+
+class Callback(PackedFunc):
+    """
+    Python callable wrapped as a native PackedFunc, pass it wherever a function is expected. Native code
+    may call it from any thread, ctypes holds the GIL only while the Python body runs. Arguments are
+    converted by converters looked up once per list of type codes. Copies native code kept stay valid
+    after close(), the callable is dropped with the last of them.
+    """
+    # (callable, lib, converters) by resource id, dropped by the finalizer
+    live = {}
+    next_id = itertools.count(1)
+    # the result of each thread, kept alive until native code copied it
+    local = threading.local()
+
+    def __init__(self, lib, fn, name=""):
+        resource = next(Callback.next_id)
+        Callback.live[resource] = (fn, lib, {})
+        handle = packedfunc_handle()
+        lib.lib.CTIPackedFuncCreate(_callback_trampoline, resource, _callback_finalizer, ctypes.byref(handle))
+        super(Callback, self).__init__(lib, handle.value, name=name or getattr(fn, "__name__", ""))
+
+    @staticmethod
+    def _converters(lib, cache, codes):
+        fast = {PackedArg.type_codes["kInt64"]: lambda v: v.v_int64,
+                PackedArg.type_codes["kFloat64"]: lambda v: v.v_float64,
+                PackedArg.type_codes["kStr"]: lambda v: v.v_str.decode()}
+        converters = cache[codes] = [fast.get(code) or Callback._convert(lib, code) for code in codes]
+        return converters
+
+    @staticmethod
+    def _convert(lib, code):
+        return lambda v: PackedArg(lib, v, type_code=code).to()
+
+    @staticmethod
+    def _call(resource, num_args, type_codes, values, ret_type, ret_val):
+        try:
+            fn, lib, cache = Callback.live[resource]
+            codes = tuple(type_codes[:num_args])
+            converters = cache.get(codes) or Callback._converters(lib, cache, codes)
+            result = fn(*[convert(values[i]) for i, convert in enumerate(converters)])
+            if result is None:
+                ret_type[0] = PackedArg.type_codes["kUnknown"]
+                return 0
+            tp, packed_value = PackedArg.from_(result)
+            ret_type[0] = PackedArg.from_typecode(tp)
+            ret_val[0] = packed_value
+            # set last, nested callbacks on the thread have returned by now
+            Callback.local.result = packed_value
+            return 0
+        except Exception:
+            traceback.print_exc()
+            return -1
+
+    def close(self):
+        if self.func_handle is not None:
+            self.lib.lib.CTIPackedFuncFree(self.func_handle)
+            self.func_handle = None
+
+    def __del__(self):
+        self.close()
+
+    def __repr__(self):
+        return "<Callback %s>" % self.name
+
+
+def _finalize_callback(resource):
+    Callback.live.pop(resource, None)
+
+
+# module level, so they outlive every function made from them
+_callback_trampoline = packedcallback_handle(Callback._call)
+_callback_finalizer = packedfinalizer_handle(_finalize_callback)
+
+
+class TypedPackedFunc(PackedFunc):
+    """
+    PackedFunc called through a stub specialized for a signature like "ii->i" or "sf->s".
+    Argument codes are i (int64), f (float64), s (str), p (pointer) and o (anything, converted like an
+    untyped call), the result may also be v to drop it. Each thread builds the stub once with its own
+    argument buffers, so a call only writes fields and crosses the FFI.
+    """
+    arg_types = {"i": ("kInt64", "v_int64"), "f": ("kFloat64", "v_float64"), "s": ("kStr", "v_str"), "p": ("kPtr", "v_void_p")}
+
+    def __init__(self, lib, func_handle, name, sig):
+        super(TypedPackedFunc, self).__init__(lib, func_handle, name=name)
+        arg_sig, arrow, ret_sig = sig.partition("->")
+        if not arrow or any(c not in "ifspo" for c in arg_sig) or ret_sig not in ("i", "f", "s", "p", "o", "v"):
+            raise ValueError("invalid signature %s" % sig)
+        self.sig = sig
+        self.local = threading.local()
+
+    def __call__(self, *args):
+        try:
+            stub = self.local.stub
+        except AttributeError:
+            stub = self.local.stub = self._make_stub()
+        return stub(*args)
+
+    def _make_stub(self):
+        arg_sig, _, ret_sig = self.sig.partition("->")
+        num_args = len(arg_sig)
+        type_codes = (packedtypecode * num_args)()
+        values = (packedvalue_handle * num_args)()
+        ret_type = packedtypecode()
+        ret_val = packedvalue_handle()
+        # a function object of its own without argtypes, so ctypes does not check every argument,
+        # which is why every argument is a ctypes object already
+        call = self.lib.lib["CTIPackedFuncCall"]
+        call.restype = ctypes.c_int
+        env = {
+            "call": call, "handle": ctypes.c_void_p(self.func_handle), "num_args": ctypes.c_size_t(num_args),
+            "type_codes": type_codes, "values": values, "ret_type": ret_type, "ret_val": ret_val,
+            "ret_type_p": ctypes.byref(ret_type), "ret_val_p": ctypes.byref(ret_val), "busy": [False],
+            "PackedArg": PackedArg, "lib": self.lib, "fallback": super(TypedPackedFunc, self).__call__,
+        }
+        params = ", ".join("a%d" % i for i in range(num_args))
+        body = []
+        for i, c in enumerate(arg_sig):
+            if c == "o":
+                body += ["tp%d, v%d = PackedArg.from_(a%d)" % (i, i, i),
+                         "type_codes[%d] = PackedArg.from_typecode(tp%d)" % (i, i),
+                         "values[%d] = v%d" % (i, i)]
+                continue
+            name, field = TypedPackedFunc.arg_types[c]
+            type_codes[i] = PackedArg.type_codes[name]
+            # slots share memory with values, so writes need no indexing on the call path
+            env["s%d" % i] = values[i]
+            body.append("s%d.%s = a%d%s" % (i, field, i, ".encode()" if c == "s" else ""))
+        body.append("call(handle, num_args, type_codes, values, ret_type_p, ret_val_p)")
+        if ret_sig == "v":
+            result = ["return None"]
+        elif ret_sig == "o":
+            result = ["return PackedArg(lib, ret_val, type_code=ret_type.value).to()"]
+        else:
+            name, field = TypedPackedFunc.arg_types[ret_sig]
+            result = ["if ret_type.value != %d:" % PackedArg.type_codes[name],
+                      "    return PackedArg(lib, ret_val, type_code=ret_type.value).to()",
+                      "return ret_val.%s%s" % (field, ".decode()" if ret_sig == "s" else "")]
+        # a nested call on the same thread, e.g. from a callback, must not reuse the buffers
+        source = "\n".join(["def stub(%s):" % params,
+                            "    if busy[0]:",
+                            "        return fallback(%s)" % params,
+                            "    busy[0] = True",
+                            "    try:"] +
+                           ["        " + line for line in body] +
+                           ["    finally:",
+                            "        busy[0] = False"] +
+                           ["    " + line for line in result])
+        exec(source, env)
+        return env["stub"]
+
+    def __repr__(self):
+        return "<TypedPackedFunc %s %s>" % (self.name, self.sig)
+
+
 class Lib:
     funcname_encoding = "ascii"
 
     def __init__(self, libname, hint=""):
         self.libpath = Lib._find_lib(libname, hint=hint)
         self.lib = Lib._load_lib(self.libpath)
+        PackedArg.LoadTypes(self.TypeList())
 
     @staticmethod
     def _find_lib(libname, hint):
@@ -267,13 +1063,108 @@ class Lib:
         lib.CTIRegistryListNames.argtypes = [c_char_p, POINTER(c_size_t), POINTER(POINTER(c_char_p))]
         lib.CTIRegistryListNames.restype = c_int
 
+        lib.CTIRegistryFreeze.argtypes = [c_char_p]
+        lib.CTIRegistryFreeze.restype = c_int
+
         lib.CTIRegistryGet.argtypes = [c_char_p, c_char_p, POINTER(packedfunc_handle)]
         lib.CTIRegistryGet.restype = c_int
 
+        lib.CTIRegistryStatsEnable.argtypes = [c_int]
+        lib.CTIRegistryStatsEnable.restype = c_int
+
+        lib.CTIRegistryStats.argtypes = [c_char_p, c_char_p, POINTER(funcstats_handle)]
+        lib.CTIRegistryStats.restype = c_int
+
+        lib.CTIRegistryStatsReset.argtypes = [c_char_p, c_char_p]
+        lib.CTIRegistryStatsReset.restype = c_int
+
         lib.CTIPackedFuncCall.argtypes = [packedfunc_handle, c_size_t,
                                           POINTER(packedtypecode), POINTER(packedvalue_handle),
                                           POINTER(packedtypecode), POINTER(packedvalue_handle)]
         lib.CTIPackedFuncCall.restype = c_int
+
+        lib.CTIPackedFuncCallOwned.argtypes = [packedfunc_handle, c_size_t,
+                                               POINTER(packedtypecode), POINTER(packedvalue_handle),
+                                               POINTER(retvalue_handle), POINTER(packedtypecode), POINTER(packedvalue_handle)]
+        lib.CTIPackedFuncCallOwned.restype = c_int
+
+        lib.CTIRetValueRelease.argtypes = [retvalue_handle]
+        lib.CTIRetValueRelease.restype = c_int
+
+        lib.CTICompletionQueueCreate.argtypes = [POINTER(completionqueue_handle)]
+        lib.CTICompletionQueueCreate.restype = c_int
+
+        lib.CTICompletionQueueFree.argtypes = [completionqueue_handle]
+        lib.CTICompletionQueueFree.restype = c_int
+
+        lib.CTIPackedFuncCallAsync.argtypes = [packedfunc_handle, c_size_t,
+                                               POINTER(packedtypecode), POINTER(packedvalue_handle),
+                                               completionqueue_handle, POINTER(ctypes.c_uint64)]
+        lib.CTIPackedFuncCallAsync.restype = c_int
+
+        lib.CTICompletionQueueWait.argtypes = [completionqueue_handle, ctypes.c_int64, POINTER(c_int), POINTER(ctypes.c_uint64),
+                                               POINTER(retvalue_handle), POINTER(packedtypecode), POINTER(packedvalue_handle)]
+        lib.CTICompletionQueueWait.restype = c_int
+
+        lib.CTIParallelGetStats.argtypes = [POINTER(c_size_t), POINTER(ctypes.c_uint64), POINTER(ctypes.c_uint64), POINTER(ctypes.c_uint64)]
+        lib.CTIParallelGetStats.restype = c_int
+
+        lib.CTIStreamNext.argtypes = [stream_handle, POINTER(c_int), POINTER(packedtypecode), POINTER(packedvalue_handle)]
+        lib.CTIStreamNext.restype = c_int
+
+        lib.CTIStreamClose.argtypes = [stream_handle]
+        lib.CTIStreamClose.restype = c_int
+
+        lib.CTIPackedFuncCallBatch.argtypes = [packedfunc_handle, c_size_t, c_size_t,
+                                               POINTER(packedtypecode), POINTER(packedvalue_handle),
+                                               POINTER(packedtypecode), POINTER(packedvalue_handle)]
+        lib.CTIPackedFuncCallBatch.restype = c_int
+
+        lib.CTIPackedFuncCreate.argtypes = [packedcallback_handle, c_void_p, packedfinalizer_handle, POINTER(packedfunc_handle)]
+        lib.CTIPackedFuncCreate.restype = c_int
+
+        lib.CTIPackedFuncFree.argtypes = [packedfunc_handle]
+        lib.CTIPackedFuncFree.restype = c_int
+
+        lib.CTIArenaGetStats.argtypes = [POINTER(c_size_t), POINTER(c_size_t), POINTER(c_size_t),
+                                         POINTER(ctypes.c_uint64), POINTER(ctypes.c_uint64), POINTER(ctypes.c_uint64)]
+        lib.CTIArenaGetStats.restype = c_int
+
+        lib.CTIArenaSetChunkSize.argtypes = [c_size_t]
+        lib.CTIArenaSetChunkSize.restype = c_int
+
+        lib.CTITraceStart.argtypes = [c_size_t]
+        lib.CTITraceStart.restype = c_int
+
+        lib.CTITraceStop.argtypes = []
+        lib.CTITraceStop.restype = c_int
+
+        lib.CTITraceDump.argtypes = [c_char_p, POINTER(ctypes.c_uint64)]
+        lib.CTITraceDump.restype = c_int
+
+        lib.CTIMappedFileOpen.argtypes = [c_char_p, packeddtype_handle, POINTER(mappedfile_handle)]
+        lib.CTIMappedFileOpen.restype = c_int
+
+        lib.CTIMappedFileRelease.argtypes = [mappedfile_handle]
+        lib.CTIMappedFileRelease.restype = c_int
+
+        lib.CTIObjectRetain.argtypes = [object_handle]
+        lib.CTIObjectRetain.restype = c_int
+
+        lib.CTIObjectRelease.argtypes = [object_handle]
+        lib.CTIObjectRelease.restype = c_int
+
+        lib.CTITypeList.argtypes = [POINTER(c_size_t), POINTER(POINTER(packedtypecode)), POINTER(POINTER(c_char_p))]
+        lib.CTITypeList.restype = c_int
+
+        lib.CTITypeGetInfo.argtypes = [packedtypecode, POINTER(c_char_p), POINTER(c_size_t), POINTER(ctypes.c_uint)]
+        lib.CTITypeGetInfo.restype = c_int
+
+        lib.CTITypeCopy.argtypes = [packedtypecode, c_void_p, POINTER(c_void_p)]
+        lib.CTITypeCopy.restype = c_int
+
+        lib.CTITypeFree.argtypes = [packedtypecode, c_void_p]
+        lib.CTITypeFree.restype = c_int
         return lib
 
     def RegistryListNames(self, registry_name="PackedFunc"):
@@ -282,12 +1173,100 @@ class Lib:
         self.lib.CTIRegistryListNames(registry_name.encode(Lib.funcname_encoding), ctypes.byref(ret_size), ctypes.byref(ret_names))
         return [ret_names[i].decode(Lib.funcname_encoding) for i in range(ret_size.value)]
 
-    def Get(self, name, registry_name="PackedFunc"):
+    def RegistryStatsEnable(self, enable=True):
+        """Start or stop counting calls of registered functions, False if stats are not compiled in."""
+        return self.lib.CTIRegistryStatsEnable(int(enable)) == 0
+
+    def RegistryStats(self, name, registry_name="PackedFunc"):
+        """Calls, latencies and result bytes of a registered function, None if stats are not compiled in.
+        histogram[i] counts calls taking [2^i, 2^(i+1)) ns."""
+        stats = funcstats_handle()
+        if self.lib.CTIRegistryStats(registry_name.encode(Lib.funcname_encoding), name.encode(Lib.funcname_encoding), ctypes.byref(stats)) != 0:
+            return None
+        return {"calls": stats.calls, "total_ns": stats.total_ns, "max_ns": stats.max_ns,
+                "mean_ns": stats.total_ns / stats.calls if stats.calls else 0.0,
+                "ret_bytes": stats.ret_bytes, "histogram": list(stats.histogram)}
+
+    def RegistryStatsReset(self, name=None, registry_name="PackedFunc"):
+        """Clear the stats of name, or of every registered function."""
+        self.lib.CTIRegistryStatsReset(registry_name.encode(Lib.funcname_encoding),
+                                       None if name is None else name.encode(Lib.funcname_encoding))
+
+    def CompletionQueue(self):
+        return CompletionQueue(self)
+
+    def ParallelStats(self):
+        num_threads = ctypes.c_size_t()
+        calls, tasks, steals = ctypes.c_uint64(), ctypes.c_uint64(), ctypes.c_uint64()
+        self.lib.CTIParallelGetStats(ctypes.byref(num_threads), ctypes.byref(calls), ctypes.byref(tasks), ctypes.byref(steals))
+        return {"num_threads": num_threads.value, "calls": calls.value, "tasks": tasks.value, "steals": steals.value}
+
+    def ArenaStats(self):
+        """Stats of the calling thread's arena, which holds call results until the next call."""
+        used, reserved, high_water = ctypes.c_size_t(), ctypes.c_size_t(), ctypes.c_size_t()
+        resets, allocations, oversized = ctypes.c_uint64(), ctypes.c_uint64(), ctypes.c_uint64()
+        self.lib.CTIArenaGetStats(ctypes.byref(used), ctypes.byref(reserved), ctypes.byref(high_water),
+                                  ctypes.byref(resets), ctypes.byref(allocations), ctypes.byref(oversized))
+        return {"used": used.value, "reserved": reserved.value, "high_water": high_water.value,
+                "resets": resets.value, "allocations": allocations.value, "oversized": oversized.value}
+
+    def ArenaSetChunkSize(self, chunk_size):
+        self.lib.CTIArenaSetChunkSize(chunk_size)
+
+    def TraceStart(self, events_per_thread=0):
+        """Record a span for every native call, nested ones included, False if tracing is not compiled in."""
+        return self.lib.CTITraceStart(events_per_thread) == 0
+
+    def TraceStop(self):
+        self.lib.CTITraceStop()
+
+    def TraceDump(self, path):
+        """Write the spans as Chrome trace-event JSON, returns the number of spans dropped for lack of room."""
+        dropped = ctypes.c_uint64()
+        if self.lib.CTITraceDump(path.encode(), ctypes.byref(dropped)) != 0:
+            raise IOError("could not write trace to %s" % path)
+        return dropped.value
+
+    def TypeList(self):
+        """(code, name) of every type registered in the native library."""
+        ret_size = ctypes.c_size_t()
+        ret_codes = ctypes.POINTER(packedtypecode)()
+        ret_names = ctypes.POINTER(ctypes.c_char_p)()
+        self.lib.CTITypeList(ctypes.byref(ret_size), ctypes.byref(ret_codes), ctypes.byref(ret_names))
+        return [(ret_codes[i], ret_names[i].decode(Lib.funcname_encoding)) for i in range(ret_size.value)]
+
+    def TypeCode(self, name):
+        for code, n in self.TypeList():
+            if n == name:
+                return code
+        raise KeyError("type %s is not registered" % name)
+
+    def TypeInfo(self, type_code):
+        name, size, flags = ctypes.c_char_p(), ctypes.c_size_t(), ctypes.c_uint()
+        if self.lib.CTITypeGetInfo(type_code, ctypes.byref(name), ctypes.byref(size), ctypes.byref(flags)) != 0:
+            raise KeyError("type code %d is not registered" % type_code)
+        return {"name": name.value.decode(Lib.funcname_encoding), "size": size.value, "refcounted": bool(flags.value & 1)}
+
+    def Callback(self, fn, name=""):
+        """Wrap a Python callable as a PackedFunc native functions can take, see Callback."""
+        return Callback(self, fn, name=name)
+
+    def MappedFile(self, path, typecode="B"):
+        """Map the file at path as a 1-d tensor of array.array typecode."""
+        return MappedFile.open(self, path, typecode)
+
+    def RegistryFreeze(self, registry_name="PackedFunc"):
+        self.lib.CTIRegistryFreeze(registry_name.encode(Lib.funcname_encoding))
+
+    def Get(self, name, registry_name="PackedFunc", sig=None):
+        """With sig, e.g. "ii->i", calls go through a stub specialized for it, see TypedPackedFunc."""
         ret_handle = packedfunc_handle()
         self.lib.CTIRegistryGet(registry_name.encode(Lib.funcname_encoding), name.encode(Lib.funcname_encoding), ctypes.byref(ret_handle))
+        if sig is not None:
+            return TypedPackedFunc(self, ret_handle.value, name, sig)
         return PackedFunc(self, ret_handle.value, name=name)
 
-    def PackedFuncCall(self, func_handle, *args):
+    def _pack_args(self, args):
         num_args = len(args)
         packed_args = [PackedArg(self, x) for x in args]
         type_codes = (packedtypecode * num_args)()
@@ -295,8 +1274,43 @@ class Lib:
         for i, x in enumerate(packed_args):
             type_codes[i] = x.type_code
             values[i] = x.value
+        return packed_args, type_codes, values
+
+    def PackedFuncCall(self, func_handle, *args):
+        packed_args, type_codes, values = self._pack_args(args)
         ret_type = packedtypecode()
         ret_val = packedvalue_handle()
-        self.lib.CTIPackedFuncCall(func_handle, num_args, type_codes, values, ctypes.byref(ret_type), ctypes.byref(ret_val))
+        self.lib.CTIPackedFuncCall(func_handle, len(args), type_codes, values, ctypes.byref(ret_type), ctypes.byref(ret_val))
         ret = PackedArg(self, ret_val, type_code=ret_type.value)
         return ret.to()
+
+    def PackedFuncCallOwned(self, func_handle, *args):
+        packed_args, type_codes, values = self._pack_args(args)
+        ret_handle = retvalue_handle()
+        ret_type = packedtypecode()
+        ret_val = packedvalue_handle()
+        self.lib.CTIPackedFuncCallOwned(func_handle, len(args), type_codes, values,
+                                        ctypes.byref(ret_handle), ctypes.byref(ret_type), ctypes.byref(ret_val))
+        return RetValue(self, ret_handle.value, ret_type.value, ret_val)
+
+    def PackedFuncCallBatch(self, func_handle, rows):
+        """Call func_handle once per tuple in rows through a single FFI crossing."""
+        rows = list(rows)
+        num_calls = len(rows)
+        num_args = len(rows[0]) if num_calls else 0
+        type_codes = (packedtypecode * (num_calls * num_args))()
+        values = (packedvalue_handle * (num_calls * num_args))()
+        # keep converted arguments alive until the call returns
+        packed_args = []
+        for i, row in enumerate(rows):
+            if len(row) != num_args:
+                raise ValueError("rows should have the same number of args")
+            for j, x in enumerate(row):
+                arg = PackedArg(self, x)
+                packed_args.append(arg)
+                type_codes[i * num_args + j] = arg.type_code
+                values[i * num_args + j] = arg.value
+        ret_types = (packedtypecode * num_calls)()
+        ret_vals = (packedvalue_handle * num_calls)()
+        self.lib.CTIPackedFuncCallBatch(func_handle, num_calls, num_args, type_codes, values, ret_types, ret_vals)
+        return [PackedArg(self, ret_vals[i], type_code=ret_types[i]).to() for i in range(num_calls)]
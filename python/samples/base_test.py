@@ -1,29 +1,84 @@
+import array
+import ctypes
+import json
 import sys
 import os
+import tempfile
 sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), "..")))
 try:
     from .ext import ExtTest
-    from .test_ctypes import lib
+    from .test_ctypes import lib, Tensor, Ragged
 except:
     from ext import ExtTest
-    from test_ctypes import lib
+    from test_ctypes import lib, Tensor, Ragged
 
 
 def test_ext():
     ext = ExtTest.new()
     print(lib.Get("ext_transform")(ext))
-    # could not inline new like this
-    #print(lib.Get("ext_transform")(ExtTest.new()))
-    # unlike c++, the scope of temp var is not the statement
+    # results hold their own reference, so the argument may be dropped right away
+    print(lib.Get("ext_transform")(ExtTest.new()))
     del ext
 
 def test_base():
+    lib.RegistryFreeze()
     fs = {k: lib.Get(k) for k in lib.RegistryListNames()}
     print(fs.keys())
+    print("types:", lib.TypeList(), lib.TypeInfo(ExtTest.type_code))
     print("hello: 1+2=", fs['hello'](1, 2))
-    print("append_str:", fs['append_str']("hello", "world"))
+    hello, append_str = lib.Get("hello", sig="ii->i"), lib.Get("append_str", sig="ss->s")
+    print("typed:", hello, hello(1, 2), append_str("typed", "stub"), lib.Get("tensor_sum", sig="o->f")(Tensor(array.array("d", [1, 2]))))
+    queue = lib.CompletionQueue()
+    tickets = {fs['hello'].call_async(queue, i, 100): i for i in range(4)}
+    results = [queue.wait() for _ in tickets]
+    print("hello async:", sorted((tickets[t], r.to()) for t, r in results), "drained:", queue.wait() is None)
+    print("hello batch:", fs['hello'].batch([(i, 10) for i in range(4)]))
+    print("append_str:", fs['append_str']("hello", "world"), lib.ArenaStats())
+    rets = [fs['append_str'].call_owned("hello", x) for x in ("world", "again")]
+    print("append_str owned:", [x.to() for x in rets])
+    blob = bytearray(b"a\0b\0c")
+    print("bytes_len:", fs['bytes_len'](blob), fs['bytes_len'](memoryview(blob)[1:]), fs['bytes_len']("hello"),
+          "bytes_reverse:", fs['bytes_reverse'](b"a\0b\0c"))
     print("test_append_str:", fs['test_append_str'](fs['append_str'], "append", "str"))
     print("vector_add:", fs['vector_add']([[1,2,3],[4]], [1,2,3,4]))
+    print("vector_sum:", fs['vector_sum']([[1, 2, 3], [4]]))
+    print("ragged_sums:", fs['ragged_sums'](Ragged([[1, 2, 3], [], [4]])), "ragged_range:", fs['ragged_range'](4))
+    print("range_stream:", [chunk for chunk in fs['range_stream'](5, 2)])
+    t = Tensor(array.array("d", [1, 2, 3, 4, 5, 6]), shape=(2, 3))
+    print("tensor_sum:", fs['tensor_sum'](t), fs['tensor_sum'](Tensor((ctypes.c_int64 * 3)(1, 2, 3))))
+    print("tensor_scale:", fs['tensor_scale'](t, 2.0).tolist())
+    values = array.array("d", [1, 2, 3, 4, 5, 6])
+    print("buffers:", fs['tensor_sum'](values), fs['tensor_sum'](memoryview(values).cast("B").cast("d", (2, 3))),
+          fs['tensor_sum'](memoryview(array.array("q", [1, 2, 3]))[::2]), fs['vector_dot'](values, [1.0, 0.0, 1.0, 0.0, 1.0, 0.0]))
+    scaled, ranges = fs['tensor_scale'].call_owned(values, 0.5), fs['ragged_sums'].call_owned(Ragged([[1, 2], [3]]))
+    print("buffer views:", scaled.buffer().tolist(), ranges.buffer().tolist(), fs['vec_mul']([1.0, 2.0], [3.0, 4.0]))
+    path = os.path.join(tempfile.gettempdir(), "cti_base_test.bin")
+    with open(path, "wb") as f:
+        array.array("d", [1, 2, 3, 4]).tofile(f)
+    with lib.MappedFile(path, "d") as mapped:
+        print("mmap tensor_sum:", fs['tensor_sum'](mapped), mapped)
+    mapped = fs['mmap_open'](path, 2, 64)
+    print("mmap_open:", mapped, fs['tensor_sum'](mapped))
+    mapped.close()
+    os.remove(path)
+    print("parallel_map:", fs['parallel_map']([1, 2, 3, 4], fs['square']), lib.ParallelStats())
+    cube, exclaim = lib.Callback(lambda x: x * x * x), lib.Callback(lambda a, b: a + b + "!")
+    print("callback:", fs['parallel_map']([1, 2, 3, 4], cube), fs['test_append_str'](exclaim, "call", "back"), cube(3))
+    lib.RegistryStatsReset("square")
+    lib.RegistryStatsEnable()
+    fs['parallel_map']([1, 2, 3, 4], fs['square'])
+    lib.RegistryStatsEnable(False)
+    stats = lib.RegistryStats("square")
+    print("stats:", stats and {k: stats[k] for k in ("calls", "ret_bytes")})
+    path = os.path.join(tempfile.gettempdir(), "cti_base_test.json")
+    if lib.TraceStart():
+        fs['test_append_str'](fs['append_str'], "trace", "me")
+        lib.TraceStop()
+        lib.TraceDump(path)
+        with open(path) as f:
+            events = json.load(f)["traceEvents"]
+        os.remove(path)
+        print("trace:", [(e["name"], e["args"]["type_codes"]) for e in events])
 
 
 if __name__ == "__main__":
@@ -0,0 +1,61 @@
+"""
+Per-call latency of the bench_<kind> functions of test_ctypes through python/cti, untyped and through
+a TypedPackedFunc stub. Results are written in the same form as samples/bench.cc and rust/samples/bench.rs.
+
+usage: python3 bench.py [--json PATH] [--iterations N]
+"""
+import argparse
+import json
+import os
+import sys
+import time
+sys.path.append(os.path.abspath(os.path.join(os.path.dirname(__file__), "..")))
+try:
+    from .ext import ExtTest
+    from .test_ctypes import lib
+except:
+    from ext import ExtTest
+    from test_ctypes import lib
+
+
+def bench(results, api, kind, n, f, args):
+    for _ in range(n // 10):
+        f(*args)
+    start = time.perf_counter()
+    for _ in range(n):
+        f(*args)
+    ns = (time.perf_counter() - start) * 1e9 / n
+    print("%s %s: %.1f ns/call" % (api, kind, ns))
+    results.append({"api": api, "kind": kind, "iterations": n, "ns_per_call": ns, "calls_per_sec": 1e9 / ns})
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("--json", help="write the results to this file")
+    parser.add_argument("--iterations", type=int, default=100000)
+    options = parser.parse_args()
+
+    square = lib.Get("square")
+    ext = ExtTest.new()
+    # kind: (args, signature of the typed stub)
+    kinds = [
+        ("int64", (1, 2), "ii->i"),
+        ("float64", (1.5, 2.0), "ff->f"),
+        ("str", ("hello",), "s->i"),
+        ("func", (square,), "o->i"),
+        ("vector", ([0.5] * 16,), "o->f"),
+        ("nested", ([[1] * 4 for _ in range(4)],), "o->i"),
+        ("ext", (ext,), "o->i"),
+    ]
+    results = []
+    for kind, args, sig in kinds:
+        name = "bench_" + kind
+        bench(results, "python", kind, options.iterations, lib.Get(name), args)
+        bench(results, "python typed", kind, options.iterations, lib.Get(name, sig=sig), args)
+    if options.json:
+        with open(options.json, "w") as f:
+            json.dump({"lang": "python", "results": results}, f, indent=2)
+
+
+if __name__ == "__main__":
+    main()
@@ -7,7 +7,7 @@ except:
 class ExtTest(ExtBaseCls):
     ext_get = lib.Get("ext_get")
     ext_new = lib.Get("ext_new")
-    ext_release = lib.Get("ext_release")
+    refcounted = True
 
     @classproperty
     def ext_name(cls):
@@ -15,7 +15,7 @@ class ExtTest(ExtBaseCls):
 
     @classproperty
     def type_code(cls):
-        return 32
+        return lib.TypeCode("ext::test")
 
     def __init__(self, lib, handle):
         super(ExtTest, self).__init__(lib, handle)
@@ -28,10 +28,6 @@ class ExtTest(ExtBaseCls):
     def _new(cls):
         return cls.ext_new()
 
-    def _release(self):
-        self.ext_release(self)
-        self.is_py = False
-
     def __repr__(self):
         return "<%s 0x%x %s>" % (self.ext_name, self.handle, self.name)
 
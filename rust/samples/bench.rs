@@ -0,0 +1,115 @@
+//! Per-call latency of the bench_<kind> functions of test_ctypes through packed_call! and
+//! TypedPackedFunc. Results are written in the same form as samples/bench.cc and python/samples/bench.py.
+//!
+//! usage: cargo run --release --bin bench -- [--json PATH] [--iterations N] [--lib PATH]
+
+#[macro_use]
+extern crate cti;
+use cti::*;
+use std::ffi::{CStr, CString};
+use std::fmt::Write;
+use std::time::Instant;
+
+#[derive(Debug)]
+pub struct ExtTest<'lib> {
+    handle: HandleType,
+    is_owned: bool,
+    lib: &'lib Lib,
+}
+
+impl_packed_ext!(ExtTest<'lib>, 32, new="ext_new", object);
+
+struct BenchResult {
+    api: &'static str,
+    kind: &'static str,
+    iterations: usize,
+    ns_per_call: f64,
+}
+
+fn bench<F: FnMut() -> f64>(results: &mut Vec<BenchResult>, api: &'static str, kind: &'static str, n: usize, mut f: F) {
+    let mut checksum = 0.;
+    for _ in 0..n / 10 {
+        checksum += f();
+    }
+    let start = Instant::now();
+    for _ in 0..n {
+        checksum += f();
+    }
+    let elapsed = start.elapsed();
+    let ns = (elapsed.as_secs() as f64 * 1e9 + elapsed.subsec_nanos() as f64) / n as f64;
+    println!("{} {}: {:.1} ns/call (checksum {})", api, kind, ns, checksum);
+    results.push(BenchResult { api, kind, iterations: n, ns_per_call: ns });
+}
+
+fn to_json(results: &[BenchResult]) -> String {
+    let mut s = String::from("{\"lang\": \"rust\", \"results\": [");
+    for (i, r) in results.iter().enumerate() {
+        write!(s, "{}\n  {{\"api\": \"{}\", \"kind\": \"{}\", \"iterations\": {}, \"ns_per_call\": {}, \"calls_per_sec\": {}}}",
+               if i == 0 { "" } else { "," }, r.api, r.kind, r.iterations, r.ns_per_call, 1e9 / r.ns_per_call).unwrap();
+    }
+    s.push_str("\n]}\n");
+    s
+}
+
+fn main() {
+    let mut json_path = None;
+    let mut n = 1000000;
+    let mut lib_path = String::from(if cfg!(target_os = "macos") { "../build/libtest_ctypes.dylib" } else { "../build/libtest_ctypes.so" });
+    let args: Vec<String> = std::env::args().collect();
+    for pair in args[1..].chunks(2) {
+        match (pair[0].as_str(), pair.get(1)) {
+            ("--json", Some(v)) => json_path = Some(v.clone()),
+            ("--iterations", Some(v)) => n = v.parse().unwrap(),
+            ("--lib", Some(v)) => lib_path = v.clone(),
+            _ => panic!("unknown argument {}", pair[0]),
+        }
+    }
+    let lib: Lib = Lib::open(lib_path.as_ref()).unwrap();
+    let tag = CStr::from_bytes_with_nul(b"PackedFunc\0").unwrap();
+    let get = |kind: &str| lib.registry_get("PackedFunc", &format!("bench_{}", kind));
+    let square = lib.registry_get("PackedFunc", "square");
+    let hello = CString::new("hello").unwrap();
+    let vector = vec!(0.5f64; 16);
+    let nested = vec!(vec!(1i64; 4); 4);
+    let ext = ExtTest::new(&lib);
+    let mut results = Vec::new();
+
+    // packed_call! takes its arguments by value, so the vectors are cloned on every call as a caller would
+    let f = get("int64");
+    bench(&mut results, "rust", "int64", n, || { let r: i64 = packed_call!(f, 1i64, 2i64); r as f64 });
+    let f: TypedPackedFunc<(i64, i64), i64> = lib.registry_get_typed(tag, CStr::from_bytes_with_nul(b"bench_int64\0").unwrap());
+    bench(&mut results, "rust typed", "int64", n, || unsafe { f.call((1, 2)) } as f64);
+
+    let f = get("float64");
+    bench(&mut results, "rust", "float64", n, || packed_call!(f, 1.5f64, 2.0f64));
+    let f = get("float64").typed::<(f64, f64), f64>();
+    bench(&mut results, "rust typed", "float64", n, || unsafe { f.call((1.5, 2.0)) });
+
+    let f = get("str");
+    bench(&mut results, "rust", "str", n, || { let r: i64 = packed_call!(f, "hello"); r as f64 });
+    let f = get("str").typed::<(&CStr,), i64>();
+    bench(&mut results, "rust typed", "str", n, || unsafe { f.call((&hello,)) } as f64);
+
+    let f = get("func");
+    bench(&mut results, "rust", "func", n, || {
+        let r: i64 = packed_call!(f, PackedFunc { name: None, handle: square.handle, lib: &lib });
+        r as f64
+    });
+    let f = get("func").typed::<(&PackedFunc,), i64>();
+    bench(&mut results, "rust typed", "func", n, || unsafe { f.call((&square,)) } as f64);
+
+    let f = get("vector");
+    bench(&mut results, "rust", "vector", n, || packed_call!(f, vector.clone()));
+
+    let f = get("nested");
+    bench(&mut results, "rust", "nested", n, || { let r: i64 = packed_call!(f, nested.clone()); r as f64 });
+
+    let f = get("ext");
+    bench(&mut results, "rust", "ext", n, || { let r: i64 = packed_call!(f, &ext); r as f64 });
+    let f = get("ext").typed::<(&ExtTest,), i64>();
+    bench(&mut results, "rust typed", "ext", n, || unsafe { f.call((&ext,)) } as f64);
+
+    if let Some(path) = json_path {
+        std::fs::write(&path, to_json(&results)).unwrap();
+    }
+}
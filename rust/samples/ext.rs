@@ -9,7 +9,7 @@ pub struct ExtTest<'lib> {
     lib: &'lib Lib,
 }
 
-impl_packed_ext!(ExtTest<'lib>, 32, new="ext_new", release="ext_release");
+impl_packed_ext!(ExtTest<'lib>, 32, new="ext_new", object);
 
 impl<'lib> ExtTest<'lib> {
     pub fn name(&self) -> String {
@@ -35,10 +35,16 @@ mod tests {
 
     pub fn test_ext() {
         let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+        assert_eq!(lib.type_code("ext::test"), Some(ExtTest::CODE));
+        assert!(lib.type_info(ExtTest::CODE).unwrap().refcounted);
         let mut ext_test = ExtTest::new(&lib);
         println!("new_ext: {:?}", ext_test);
-        println!("transform: {:?}", ext_test.transform());
-        let name = ext_test.name();
+        let transformed = ext_test.transform();
+        println!("transform: {:?}", transformed);
+        assert!(transformed.is_owned());
+        drop(ext_test);
+        // the transformed value shares the object and keeps it alive
+        let name = transformed.name();
         println!("name: {}", name);
         assert_eq!(name, "run!");
     }
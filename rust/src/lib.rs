@@ -7,9 +7,14 @@ use std::ffi::{CStr, CString};
 use std::slice;
 use std::fmt::Debug;
 use std::convert::{From, Into};
+use std::collections::HashMap;
+use std::marker::PhantomData;
 
 pub type FuncHandle = *const c_void;
 pub type HandleType = *const c_void;
+pub type RetValueHandle = *mut c_void;
+pub type CompletionQueueHandle = *mut c_void;
+pub type MappedFileHandle = *mut c_void;
 pub type _PackedType = c_uint;
 
 trait PackedType : From<_PackedType> + Into<_PackedType> { }
@@ -28,7 +33,7 @@ pub trait _PackedExt: Drop {
     fn _release(&self);
 }
 
-#[derive(Debug)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
 pub enum PackedTypeCode {
     Unknown = 0,
     Int64 = 1,
@@ -37,6 +42,11 @@ pub enum PackedTypeCode {
     Str = 4,
     Func = 5,
     Vector = 6,
+    Stream = 7,
+    Tensor = 8,
+    Ragged = 9,
+    Bytes = 10,
+    MappedFile = 11,
 }
 
 impl Into<_PackedType> for PackedTypeCode {
@@ -45,18 +55,26 @@ impl Into<_PackedType> for PackedTypeCode {
     }
 }
 
+// indexed by code, ext types and anything unknown are passed as pointers
+const PACKED_TYPE_CODES: [PackedTypeCode; 12] = [
+    PackedTypeCode::Unknown,
+    PackedTypeCode::Int64,
+    PackedTypeCode::Float64,
+    PackedTypeCode::Ptr,
+    PackedTypeCode::Str,
+    PackedTypeCode::Func,
+    PackedTypeCode::Vector,
+    PackedTypeCode::Stream,
+    PackedTypeCode::Tensor,
+    PackedTypeCode::Ragged,
+    PackedTypeCode::Bytes,
+    PackedTypeCode::MappedFile,
+];
+
 impl From<_PackedType> for PackedTypeCode {
+    #[inline]
     fn from(type_code: _PackedType) -> Self {
-        match type_code {
-            i if i == (PackedTypeCode::Unknown as _PackedType) => PackedTypeCode::Unknown,
-            i if i == (PackedTypeCode::Int64 as _PackedType) => PackedTypeCode::Int64,
-            i if i == (PackedTypeCode::Float64 as _PackedType) => PackedTypeCode::Float64,
-            i if i == (PackedTypeCode::Ptr as _PackedType) => PackedTypeCode::Ptr,
-            i if i == (PackedTypeCode::Str as _PackedType) => PackedTypeCode::Str,
-            i if i == (PackedTypeCode::Func as _PackedType) => PackedTypeCode::Func,
-            i if i == (PackedTypeCode::Vector as _PackedType) => PackedTypeCode::Vector,
-            _ => PackedTypeCode::Ptr,
-        }
+        PACKED_TYPE_CODES.get(type_code as usize).cloned().unwrap_or(PackedTypeCode::Ptr)
     }
 }
 
@@ -75,6 +93,126 @@ pub struct ManagedPackedVec<'lib> {
     managed: Vec<ManagedPackedArg<'lib>>,
 }
 
+/// Element type of a tensor, code is 0 for int, 1 for uint and 2 for float.
+#[repr(C)]
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub struct PackedDType {
+    pub code: u8,
+    pub bits: u8,
+    pub lanes: u16,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+struct _PackedTensor {
+    data: *mut c_void,
+    dtype: PackedDType,
+    ndim: i32,
+    shape: *const int64_t,
+    strides: *const int64_t,
+}
+
+/// Element types a Tensor could hold.
+pub trait DType: Copy + Default {
+    const DTYPE: PackedDType;
+}
+
+macro_rules! packed_dtype {
+    ( $t:ty, $code:expr ) => {
+        impl DType for $t {
+            const DTYPE: PackedDType = PackedDType{ code: $code, bits: (std::mem::size_of::<$t>() * 8) as u8, lanes: 1 };
+        }
+    };
+}
+
+packed_dtype!(i8, 0);
+packed_dtype!(i16, 0);
+packed_dtype!(i32, 0);
+packed_dtype!(i64, 0);
+packed_dtype!(u8, 1);
+packed_dtype!(u16, 1);
+packed_dtype!(u32, 1);
+packed_dtype!(u64, 1);
+packed_dtype!(f32, 2);
+packed_dtype!(f64, 2);
+
+/// Compact row-major tensor, passed to native code without copying.
+#[derive(Debug, Clone, PartialEq)]
+pub struct Tensor<T: DType> {
+    pub data: Vec<T>,
+    pub shape: Vec<i64>,
+}
+
+/// Tensor returned from native code, copied into a compact buffer of any dtype.
+#[derive(Debug, Clone)]
+pub struct AnyTensor {
+    pub dtype: PackedDType,
+    pub shape: Vec<i64>,
+    pub bytes: Vec<u8>,
+}
+
+/// Tensor borrowed from a RetValue, valid as long as the borrow, see RetValue::as_tensor.
+#[derive(Debug, Clone, Copy)]
+pub struct TensorView<'a> {
+    pub dtype: PackedDType,
+    pub shape: &'a [i64],
+    /// element strides, None if compact row-major
+    pub strides: Option<&'a [i64]>,
+    data: *const c_void,
+}
+
+#[derive(Debug)]
+pub struct ManagedPackedTensor {
+    packed_tensor: _PackedTensor,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+struct _PackedBytes {
+    data: *const u8,
+    size: size_t,
+}
+
+/// kBytes result copied out of native memory, arguments are passed as &[u8] without copying.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Bytes(pub Vec<u8>);
+
+#[derive(Debug)]
+pub struct ManagedPackedBytes {
+    packed_bytes: _PackedBytes,
+}
+
+/// Read-only mapping of a file viewed as a 1-d tensor, passed as kMappedFile without copying
+/// and accepted by functions taking a tensor. Unmapped on drop.
+#[derive(Debug)]
+pub struct MappedFile<'lib> {
+    handle: MappedFileHandle,
+    lib: &'lib Lib,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+struct _PackedRagged {
+    values: *const _PackedValue,
+    offsets: *const int64_t,
+    num_rows: size_t,
+    type_code: _PackedType,
+}
+
+/// Rows of varying length in one values buffer, row i is values[offsets[i]..offsets[i+1]].
+#[derive(Debug, Clone, PartialEq)]
+pub struct Ragged<T> {
+    pub values: Vec<T>,
+    pub offsets: Vec<i64>,
+}
+
+#[derive(Debug)]
+pub struct ManagedPackedRagged<'lib> {
+    packed_ragged: _PackedRagged,
+    values: Vec<_PackedValue>,
+    managed: Vec<ManagedPackedArg<'lib>>,
+}
+
 #[repr(C)]
 #[derive(Copy, Clone)]
 pub union _PackedValue {
@@ -92,11 +230,16 @@ struct _PackedArg {
     value: _PackedValue,
 }
 
+/// Arguments packed for a call. Tensors, bytes and ragged arrays are passed by pointer, so
+/// everything they borrow has to outlive 'lib.
 #[derive(Debug)]
 pub enum ManagedPackedArg<'lib> {
     Base(PackedArg<'lib>),
     String(CString),
     Vec(ManagedPackedVec<'lib>),
+    Tensor(ManagedPackedTensor),
+    Ragged(ManagedPackedRagged<'lib>),
+    Bytes(ManagedPackedBytes),
 }
 
 #[derive(Debug)]
@@ -109,9 +252,88 @@ pub enum PackedArg<'lib> {
     Ptr(&'lib Lib, *const c_void),
     Func(PackedFunc<'lib>),
     Vec(Vec<PackedArg<'lib>>),
+    Stream(PackedStream<'lib>),
+    Tensor(AnyTensor),
+    Ragged(Ragged<PackedArg<'lib>>),
+    Bytes(Bytes),
+    MappedFile(MappedFile<'lib>),
     Ext(&'lib Lib, c_uint, *const c_void),
 }
 
+#[derive(Debug, Clone, Copy)]
+pub struct ParallelStats {
+    pub num_threads: size_t,
+    pub calls: u64,
+    pub tasks: u64,
+    pub steals: u64,
+}
+
+pub const STATS_BUCKETS: usize = 32;
+
+/// Counters of a registered function, histogram[i] counts calls taking [2^i, 2^(i+1)) ns.
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct FuncStats {
+    pub calls: u64,
+    pub total_ns: u64,
+    pub max_ns: u64,
+    /// bytes of strings, vectors, tensors... owned by the results
+    pub ret_bytes: u64,
+    pub histogram: [u64; STATS_BUCKETS],
+}
+
+impl FuncStats {
+    pub fn mean_ns(&self) -> f64 {
+        if self.calls == 0 { 0. } else { self.total_ns as f64 / self.calls as f64 }
+    }
+}
+
+/// Arena of the calling thread, which holds call results until the next call.
+#[derive(Debug, Clone, Copy)]
+pub struct ArenaStats {
+    pub used: size_t,
+    pub reserved: size_t,
+    pub high_water: size_t,
+    pub resets: u64,
+    pub allocations: u64,
+    pub oversized: u64,
+}
+
+/// A type registered in the native library, see Lib::type_list.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct TypeInfo {
+    pub code: u32,
+    pub name: String,
+    /// size of the value v_ptr points to, 0 if it is stored inline
+    pub size: usize,
+    pub refcounted: bool,
+}
+
+/// Chunks of a kStream value pulled on demand, closed on drop.
+#[derive(Debug)]
+pub struct PackedStream<'lib> {
+    handle: *mut c_void,
+    lib: &'lib Lib,
+}
+
+/// Result owned by the caller, the native value stays valid until it is dropped.
+#[derive(Debug)]
+pub struct RetValue<'lib> {
+    handle: RetValueHandle,
+    type_code: _PackedType,
+    value: _PackedValue,
+    lib: &'lib Lib,
+}
+
+/// Collects results of calls running on the library's worker pool.
+#[derive(Debug)]
+pub struct CompletionQueue<'lib> {
+    handle: CompletionQueueHandle,
+    // arguments must stay alive until their call completes
+    pending: HashMap<u64, Vec<ManagedPackedArg<'lib>>>,
+    lib: &'lib Lib,
+}
+
 #[derive(Debug)]
 pub struct PackedFunc<'lib> {
     pub name: Option<String>,
@@ -119,6 +341,36 @@ pub struct PackedFunc<'lib> {
     pub lib: &'lib Lib,
 }
 
+/// PackedFunc with a fixed signature, e.g. TypedPackedFunc<(i64, i64), i64>. Arguments are written
+/// into arrays on the stack and the result is read without going through PackedArg, so a call
+/// allocates nothing. As with PackedFunc::call, the handle is not checked, so calling is unsafe.
+pub struct TypedPackedFunc<'lib, A, R> {
+    pub handle: FuncHandle,
+    pub lib: &'lib Lib,
+    signature: PhantomData<fn(A) -> R>,
+}
+
+/// Argument of a typed call, its value is stored in the packed value without conversion.
+pub trait RawArg {
+    const CODE: _PackedType;
+    fn to_raw_value(&self) -> _PackedValue;
+}
+
+/// Tuple of RawArg, type codes are known at compile time and values are packed into an array.
+pub trait RawArgs {
+    type Values: AsRef<[_PackedValue]>;
+    const CODES: &'static [_PackedType];
+    fn to_raw_values(&self) -> Self::Values;
+}
+
+/// Result of a typed call, panics if the native function returned another type.
+pub trait RawRet<'lib>: Sized {
+    unsafe fn from_raw_ret(lib: &'lib Lib, type_code: _PackedType, value: _PackedValue) -> Self;
+}
+
+// arguments of untyped calls up to this count are packed on the stack
+const STACK_ARGS: usize = 8;
+
 impl Debug for _PackedValue {
     #[inline]
     fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
@@ -287,6 +539,283 @@ impl<'lib> PackedArg<'lib> {
     }
 }
 
+impl<'lib> Into<PackedStream<'lib>> for PackedArg<'lib> {
+    #[inline]
+    fn into(self) -> PackedStream<'lib> {
+        match self {
+            PackedArg::Stream(value) => value,
+            _ => panic!()
+        }
+    }
+}
+
+macro_rules! raw_arg_type {
+    ( $t:ty, $code:ident, $field:ident, $tt:ty ) => {
+        impl RawArg for $t {
+            const CODE: _PackedType = PackedTypeCode::$code as _PackedType;
+            #[inline]
+            fn to_raw_value(&self) -> _PackedValue {
+                _PackedValue{ $field: *self as $tt }
+            }
+        }
+    };
+}
+
+raw_arg_type!(i32, Int64, v_int64, i64);
+raw_arg_type!(i64, Int64, v_int64, i64);
+raw_arg_type!(f64, Float64, v_float64, c_double);
+
+// a &str would need a terminated copy, so strings are passed as &CStr
+impl<'a> RawArg for &'a CStr {
+    const CODE: _PackedType = PackedTypeCode::Str as _PackedType;
+    #[inline]
+    fn to_raw_value(&self) -> _PackedValue {
+        _PackedValue{ v_str: self.as_ptr() }
+    }
+}
+
+impl<'a, 'lib> RawArg for &'a PackedFunc<'lib> {
+    const CODE: _PackedType = PackedTypeCode::Func as _PackedType;
+    #[inline]
+    fn to_raw_value(&self) -> _PackedValue {
+        _PackedValue{ v_func: self.handle }
+    }
+}
+
+impl<'a, 'lib, T: PackedExt<'lib>> RawArg for &'a T {
+    const CODE: _PackedType = T::CODE;
+    #[inline]
+    fn to_raw_value(&self) -> _PackedValue {
+        _PackedValue{ v_ptr: self.handle() }
+    }
+}
+
+macro_rules! raw_args_tuple {
+    ( $n:expr; $($t:ident $i:tt),* ) => {
+        impl<$($t: RawArg),*> RawArgs for ($($t,)*) {
+            type Values = [_PackedValue; $n];
+            const CODES: &'static [_PackedType] = &[$(<$t as RawArg>::CODE),*];
+            #[inline]
+            fn to_raw_values(&self) -> Self::Values {
+                [$(self.$i.to_raw_value()),*]
+            }
+        }
+    };
+}
+
+raw_args_tuple!(0;);
+raw_args_tuple!(1; A 0);
+raw_args_tuple!(2; A 0, B 1);
+raw_args_tuple!(3; A 0, B 1, C 2);
+raw_args_tuple!(4; A 0, B 1, C 2, D 3);
+raw_args_tuple!(5; A 0, B 1, C 2, D 3, E 4);
+raw_args_tuple!(6; A 0, B 1, C 2, D 3, E 4, F 5);
+
+macro_rules! raw_ret_type {
+    ( $t:ty, $code:ident, $field:ident ) => {
+        impl<'lib> RawRet<'lib> for $t {
+            #[inline]
+            unsafe fn from_raw_ret(_lib: &'lib Lib, type_code: _PackedType, value: _PackedValue) -> Self {
+                assert_eq!(type_code, PackedTypeCode::$code as _PackedType);
+                value.$field as $t
+            }
+        }
+    };
+}
+
+raw_ret_type!(i64, Int64, v_int64);
+raw_ret_type!(f64, Float64, v_float64);
+
+impl<'lib> RawRet<'lib> for () {
+    #[inline]
+    unsafe fn from_raw_ret(_lib: &'lib Lib, _type_code: _PackedType, _value: _PackedValue) { }
+}
+
+// copies the string, which is the caller's choice
+impl<'lib> RawRet<'lib> for String {
+    #[inline]
+    unsafe fn from_raw_ret(_lib: &'lib Lib, type_code: _PackedType, value: _PackedValue) -> Self {
+        assert_eq!(type_code, PackedTypeCode::Str as _PackedType);
+        CStr::from_ptr(value.v_str).to_str().unwrap().to_owned()
+    }
+}
+
+impl<'lib> RawRet<'lib> for PackedArg<'lib> {
+    #[inline]
+    unsafe fn from_raw_ret(lib: &'lib Lib, type_code: _PackedType, value: _PackedValue) -> Self {
+        PackedArg::from_raw(lib, type_code, value)
+    }
+}
+
+// raw type codes and values of args, packed on the stack unless there are many
+unsafe fn with_raw_args<R, F: FnOnce(&[_PackedType], &[_PackedValue]) -> R>(args: &[ManagedPackedArg], f: F) -> R {
+    if args.len() > STACK_ARGS {
+        let raw: Vec<_PackedArg> = args.iter().map(|arg| arg.to_raw()).collect();
+        let type_codes: Vec<_PackedType> = raw.iter().map(|arg| arg.type_code).collect();
+        let values: Vec<_PackedValue> = raw.iter().map(|arg| arg.value).collect();
+        return f(&type_codes, &values);
+    }
+    let mut type_codes: [_PackedType; STACK_ARGS] = [0; STACK_ARGS];
+    let mut values = [_PackedValue { v_int64: 0 }; STACK_ARGS];
+    for (i, arg) in args.iter().enumerate() {
+        let _arg = arg.to_raw();
+        type_codes[i] = _arg.type_code;
+        values[i] = _arg.value;
+    }
+    f(&type_codes[..args.len()], &values[..args.len()])
+}
+
+impl<T: DType> Tensor<T> {
+    pub fn new(data: Vec<T>, shape: Vec<i64>) -> Self {
+        assert_eq!(data.len() as i64, shape.iter().product::<i64>());
+        Tensor { data, shape }
+    }
+}
+
+impl _PackedTensor {
+    // copy into a compact buffer, following strides if any
+    unsafe fn to_any(&self) -> AnyTensor {
+        let shape = slice::from_raw_parts(self.shape, self.ndim as usize).to_vec();
+        let size = shape.iter().product::<i64>() as usize;
+        let itemsize = (self.dtype.bits as usize * self.dtype.lanes as usize + 7) / 8;
+        let mut bytes = vec![0u8; size * itemsize];
+        let src = self.data as *const u8;
+        if self.strides.is_null() {
+            std::ptr::copy_nonoverlapping(src, bytes.as_mut_ptr(), bytes.len());
+        } else {
+            let strides = slice::from_raw_parts(self.strides, self.ndim as usize);
+            for i in 0..size {
+                let (mut offset, mut rest) = (0i64, i as i64);
+                for d in (0..shape.len()).rev() {
+                    offset += (rest % shape[d]) * strides[d];
+                    rest /= shape[d];
+                }
+                std::ptr::copy_nonoverlapping(src.offset((offset as isize) * itemsize as isize), bytes.as_mut_ptr().add(i * itemsize), itemsize);
+            }
+        }
+        AnyTensor { dtype: self.dtype, shape, bytes }
+    }
+}
+
+impl<'a: 'lib, 'lib, T: DType> From<&'a Tensor<T>> for ManagedPackedArg<'lib> {
+    #[inline]
+    fn from(value: &'a Tensor<T>) -> Self {
+        ManagedPackedArg::Tensor(ManagedPackedTensor{ packed_tensor: _PackedTensor{
+            data: value.data.as_ptr() as *mut c_void,
+            dtype: T::DTYPE,
+            ndim: value.shape.len() as i32,
+            shape: value.shape.as_ptr(),
+            strides: std::ptr::null(),
+        }})
+    }
+}
+
+impl<'lib, T: DType> Into<Tensor<T>> for PackedArg<'lib> {
+    #[inline]
+    fn into(self) -> Tensor<T> {
+        match self {
+            PackedArg::Tensor(value) => {
+                assert_eq!(value.dtype, T::DTYPE);
+                let mut data = vec![T::default(); value.bytes.len() / std::mem::size_of::<T>()];
+                unsafe {
+                    std::ptr::copy_nonoverlapping(value.bytes.as_ptr(), data.as_mut_ptr() as *mut u8, value.bytes.len());
+                }
+                Tensor { data, shape: value.shape }
+            },
+            _ => panic!()
+        }
+    }
+}
+
+impl<'a: 'lib, 'lib> From<&'a [u8]> for ManagedPackedArg<'lib> {
+    #[inline]
+    fn from(value: &'a [u8]) -> Self {
+        ManagedPackedArg::Bytes(ManagedPackedBytes{ packed_bytes: _PackedBytes{ data: value.as_ptr(), size: value.len() } })
+    }
+}
+
+impl<'lib> Into<Bytes> for PackedArg<'lib> {
+    #[inline]
+    fn into(self) -> Bytes {
+        match self {
+            PackedArg::Bytes(value) => value,
+            _ => panic!()
+        }
+    }
+}
+
+impl<'a, 'lib> From<&'a MappedFile<'lib>> for ManagedPackedArg<'lib> {
+    #[inline]
+    fn from(value: &'a MappedFile<'lib>) -> Self {
+        ManagedPackedArg::Base(PackedArg::Ext(value.lib, PackedTypeCode::MappedFile as _PackedType, value.handle))
+    }
+}
+
+impl<'lib> Into<MappedFile<'lib>> for PackedArg<'lib> {
+    #[inline]
+    fn into(self) -> MappedFile<'lib> {
+        match self {
+            PackedArg::MappedFile(value) => value,
+            _ => panic!()
+        }
+    }
+}
+
+impl<T> Ragged<T> {
+    pub fn num_rows(&self) -> usize {
+        self.offsets.len() - 1
+    }
+
+    pub fn row(&self, i: usize) -> &[T] {
+        &self.values[self.offsets[i] as usize..self.offsets[i + 1] as usize]
+    }
+}
+
+impl<T> From<Vec<Vec<T>>> for Ragged<T> {
+    fn from(rows: Vec<Vec<T>>) -> Self {
+        let mut offsets = Vec::with_capacity(rows.len() + 1);
+        offsets.push(0);
+        let mut values = Vec::with_capacity(rows.iter().map(|row| row.len()).sum());
+        for row in rows {
+            values.extend(row);
+            offsets.push(values.len() as i64);
+        }
+        Ragged { values, offsets }
+    }
+}
+
+impl<'a: 'lib, 'lib, T: Clone> From<&'a Ragged<T>> for ManagedPackedArg<'lib> where ManagedPackedArg<'lib>: std::convert::From<T> {
+    #[inline]
+    fn from(value: &'a Ragged<T>) -> Self {
+        let managed: Vec<ManagedPackedArg<'lib>> = value.values.iter().map(|x| ManagedPackedArg::from(x.clone())).collect();
+        let mut values = Vec::with_capacity(managed.len());
+        let mut type_code = PackedTypeCode::Unknown as _PackedType;
+        for a in managed.iter() {
+            unsafe {
+                let aa = a.to_raw();
+                if type_code == PackedTypeCode::Unknown as _PackedType {
+                    type_code = aa.type_code;
+                } else if aa.type_code != type_code {
+                    panic!();
+                }
+                values.push(aa.value);
+            }
+        }
+        let packed_ragged = _PackedRagged{ values: values.as_ptr(), offsets: value.offsets.as_ptr(), num_rows: value.offsets.len() - 1, type_code };
+        ManagedPackedArg::Ragged(ManagedPackedRagged{ packed_ragged, values, managed })
+    }
+}
+
+impl<'lib, T> Into<Ragged<T>> for PackedArg<'lib> where PackedArg<'lib>: std::convert::Into<T> {
+    #[inline]
+    fn into(self) -> Ragged<T> {
+        match self {
+            PackedArg::Ragged(value) => Ragged{ values: value.values.into_iter().map(|x| x.into()).collect(), offsets: value.offsets },
+            _ => panic!()
+        }
+    }
+}
+
 impl<'lib> Into<()> for PackedArg<'lib> {
     #[inline]
     fn into(self) { }
@@ -314,6 +843,9 @@ impl<'lib> ManagedPackedArg<'lib> {
             &ManagedPackedArg::Base(ref base) => base.to_raw(),
             &ManagedPackedArg::String(ref i) => _PackedArg{ type_code: PackedTypeCode::Str as _PackedType, value: _PackedValue{ v_str: i.as_ptr() } },
             &ManagedPackedArg::Vec(ref i) => _PackedArg{ type_code: PackedTypeCode::Vector as _PackedType, value: _PackedValue{ v_vec: &i.packed_vec } },
+            &ManagedPackedArg::Bytes(ref i) => _PackedArg{ type_code: PackedTypeCode::Bytes as _PackedType, value: _PackedValue{ v_ptr: &i.packed_bytes as *const _PackedBytes as *const c_void } },
+            &ManagedPackedArg::Ragged(ref i) => _PackedArg{ type_code: PackedTypeCode::Ragged as _PackedType, value: _PackedValue{ v_ptr: &i.packed_ragged as *const _PackedRagged as *const c_void } },
+            &ManagedPackedArg::Tensor(ref i) => _PackedArg{ type_code: PackedTypeCode::Tensor as _PackedType, value: _PackedValue{ v_ptr: &i.packed_tensor as *const _PackedTensor as *const c_void } },
         }
     }
 }
@@ -327,6 +859,19 @@ impl<'lib> PackedArg<'lib> {
             PackedTypeCode::Str => PackedArg::String(CStr::from_ptr(value.v_str).to_owned().into_string().unwrap()),
             PackedTypeCode::Func => PackedArg::Func(PackedFunc{ handle: value.v_func, name: None, lib }),
             PackedTypeCode::Vector => PackedArg::Vec((*value.v_vec).into_vec(lib)),
+            PackedTypeCode::Stream => PackedArg::Stream(PackedStream{ handle: value.v_ptr as *mut c_void, lib }),
+            PackedTypeCode::Tensor => PackedArg::Tensor((*(value.v_ptr as *const _PackedTensor)).to_any()),
+            PackedTypeCode::Bytes => {
+                let bytes = &*(value.v_ptr as *const _PackedBytes);
+                PackedArg::Bytes(Bytes(slice::from_raw_parts(bytes.data, bytes.size).to_vec()))
+            },
+            PackedTypeCode::MappedFile => PackedArg::MappedFile(MappedFile{ handle: value.v_ptr as *mut c_void, lib }),
+            PackedTypeCode::Ragged => {
+                let ragged = &*(value.v_ptr as *const _PackedRagged);
+                let offsets = slice::from_raw_parts(ragged.offsets, ragged.num_rows + 1).to_vec();
+                let values = slice::from_raw_parts(ragged.values, offsets[ragged.num_rows] as usize);
+                PackedArg::Ragged(Ragged{ values: values.iter().map(|&x| PackedArg::from_raw(lib, ragged.type_code, x)).collect(), offsets })
+            },
             PackedTypeCode::Ptr => {
                 if type_code == PackedTypeCode::Ptr as _PackedType {
                     PackedArg::Ptr(lib, value.v_ptr)
@@ -342,10 +887,43 @@ impl<'lib> PackedArg<'lib> {
 
 shared_library!(Lib,
     fn CTIRegistryListNames(tag: *const c_char, ret_size: *mut size_t, ret_names: *mut*const*const c_char) -> c_int,
+    fn CTIRegistryFreeze(tag: *const c_char) -> c_int,
     fn CTIRegistryGet(tag: *const c_char, name: *const c_char, handle: *mut FuncHandle) -> c_int,
+    fn CTIRegistryStatsEnable(enable: c_int) -> c_int,
+    fn CTIRegistryStats(tag: *const c_char, name: *const c_char, ret_stats: *mut FuncStats) -> c_int,
+    fn CTIRegistryStatsReset(tag: *const c_char, name: *const c_char) -> c_int,
     fn CTIPackedFuncCall(name: FuncHandle, num_args: size_t,
                          type_codes: *const _PackedType, values: *const _PackedValue,
                          ret_type: *mut _PackedType, ret_val: *mut _PackedValue) -> c_int,
+    fn CTIPackedFuncCallOwned(name: FuncHandle, num_args: size_t,
+                              type_codes: *const _PackedType, values: *const _PackedValue,
+                              ret_handle: *mut RetValueHandle, ret_type: *mut _PackedType, ret_val: *mut _PackedValue) -> c_int,
+    fn CTIRetValueRelease(handle: RetValueHandle) -> c_int,
+    fn CTICompletionQueueCreate(ret_queue: *mut CompletionQueueHandle) -> c_int,
+    fn CTICompletionQueueFree(queue: CompletionQueueHandle) -> c_int,
+    fn CTIPackedFuncCallAsync(name: FuncHandle, num_args: size_t,
+                              type_codes: *const _PackedType, values: *const _PackedValue,
+                              queue: CompletionQueueHandle, ret_ticket: *mut u64) -> c_int,
+    fn CTICompletionQueueWait(queue: CompletionQueueHandle, timeout_ms: i64, ret_ready: *mut c_int, ret_ticket: *mut u64,
+                              ret_handle: *mut RetValueHandle, ret_type: *mut _PackedType, ret_val: *mut _PackedValue) -> c_int,
+    fn CTIParallelGetStats(ret_num_threads: *mut size_t, ret_calls: *mut u64, ret_tasks: *mut u64, ret_steals: *mut u64) -> c_int,
+    fn CTIStreamNext(stream: *mut c_void, ret_has_next: *mut c_int, ret_type: *mut _PackedType, ret_val: *mut _PackedValue) -> c_int,
+    fn CTIStreamClose(stream: *mut c_void) -> c_int,
+    fn CTIPackedFuncCallBatch(name: FuncHandle, num_calls: size_t, num_args: size_t,
+                              type_codes: *const _PackedType, values: *const _PackedValue,
+                              ret_types: *mut _PackedType, ret_vals: *mut _PackedValue) -> c_int,
+    fn CTIArenaGetStats(ret_used: *mut size_t, ret_reserved: *mut size_t, ret_high_water: *mut size_t,
+                        ret_resets: *mut u64, ret_allocations: *mut u64, ret_oversized: *mut u64) -> c_int,
+    fn CTIArenaSetChunkSize(chunk_size: size_t) -> c_int,
+    fn CTITraceStart(events_per_thread: size_t) -> c_int,
+    fn CTITraceStop() -> c_int,
+    fn CTITraceDump(path: *const c_char, ret_dropped: *mut u64) -> c_int,
+    fn CTIMappedFileOpen(path: *const c_char, dtype: PackedDType, ret_handle: *mut MappedFileHandle) -> c_int,
+    fn CTIMappedFileRelease(handle: MappedFileHandle) -> c_int,
+    fn CTIObjectRetain(handle: HandleType) -> c_int,
+    fn CTIObjectRelease(handle: HandleType) -> c_int,
+    fn CTITypeList(ret_size: *mut size_t, ret_codes: *mut *const _PackedType, ret_names: *mut *const *const c_char) -> c_int,
+    fn CTITypeGetInfo(type_code: _PackedType, ret_name: *mut *const c_char, ret_size: *mut size_t, ret_flags: *mut c_uint) -> c_int,
 );
 
 impl Lib {
@@ -364,6 +942,133 @@ impl Lib {
         ret
     }
 
+    pub fn registry_freeze(&self, tag: &str) {
+        let _tag = CString::new(tag).unwrap();
+        unsafe {
+            (self.CTIRegistryFreeze)(_tag.as_ptr());
+        }
+    }
+
+    /// Start or stop counting calls of registered functions, false if the library is built without CTI_ENABLE_STATS.
+    pub fn registry_stats_enable(&self, enable: bool) -> bool {
+        unsafe { (self.CTIRegistryStatsEnable)(enable as c_int) == 0 }
+    }
+
+    /// None if there is no such function or the library is built without CTI_ENABLE_STATS.
+    pub fn registry_stats(&self, tag: &str, name: &str) -> Option<FuncStats> {
+        let _tag = CString::new(tag).unwrap();
+        let _name = CString::new(name).unwrap();
+        let mut stats = FuncStats { calls: 0, total_ns: 0, max_ns: 0, ret_bytes: 0, histogram: [0; STATS_BUCKETS] };
+        let ret = unsafe { (self.CTIRegistryStats)(_tag.as_ptr(), _name.as_ptr(), &mut stats) };
+        if ret == 0 { Some(stats) } else { None }
+    }
+
+    /// Clears the stats of name, or of every function.
+    pub fn registry_stats_reset(&self, tag: &str, name: Option<&str>) {
+        let _tag = CString::new(tag).unwrap();
+        let _name = name.map(|n| CString::new(n).unwrap());
+        unsafe {
+            (self.CTIRegistryStatsReset)(_tag.as_ptr(), _name.as_ref().map_or(std::ptr::null(), |n| n.as_ptr()));
+        }
+    }
+
+    /// Record a span for every call from now on, false if the library is built without CTI_ENABLE_TRACE.
+    pub fn trace_start(&self, events_per_thread: usize) -> bool {
+        unsafe { (self.CTITraceStart)(events_per_thread) == 0 }
+    }
+
+    pub fn trace_stop(&self) {
+        unsafe {
+            (self.CTITraceStop)();
+        }
+    }
+
+    /// Writes the spans as Chrome trace-event JSON, Some(spans dropped for lack of room) on success.
+    pub fn trace_dump(&self, path: &str) -> Option<u64> {
+        let _path = CString::new(path).unwrap();
+        let mut dropped = 0u64;
+        let ret = unsafe { (self.CTITraceDump)(_path.as_ptr(), &mut dropped) };
+        if ret == 0 { Some(dropped) } else { None }
+    }
+
+    /// Thread count and call/task/steal counters of the parallel_for/parallel_map scheduler.
+    pub fn parallel_stats(&self) -> ParallelStats {
+        let mut stats = ParallelStats { num_threads: 0, calls: 0, tasks: 0, steals: 0 };
+        unsafe {
+            (self.CTIParallelGetStats)(&mut stats.num_threads, &mut stats.calls, &mut stats.tasks, &mut stats.steals);
+        }
+        stats
+    }
+
+    pub fn arena_stats(&self) -> ArenaStats {
+        let mut stats = ArenaStats { used: 0, reserved: 0, high_water: 0, resets: 0, allocations: 0, oversized: 0 };
+        unsafe {
+            (self.CTIArenaGetStats)(&mut stats.used, &mut stats.reserved, &mut stats.high_water,
+                                    &mut stats.resets, &mut stats.allocations, &mut stats.oversized);
+        }
+        stats
+    }
+
+    pub fn arena_set_chunk_size(&self, chunk_size: usize) {
+        unsafe {
+            (self.CTIArenaSetChunkSize)(chunk_size);
+        }
+    }
+
+    /// Every type registered in the native library.
+    pub fn type_list(&self) -> Vec<TypeInfo> {
+        let mut ret_size: size_t = 0;
+        let mut ret_codes: *const _PackedType = std::ptr::null();
+        let mut ret_names: *const *const c_char = std::ptr::null();
+        unsafe {
+            (self.CTITypeList)(&mut ret_size, &mut ret_codes, &mut ret_names);
+            let codes = slice::from_raw_parts(ret_codes, ret_size).to_vec();
+            codes.into_iter().filter_map(|code| self.type_info(code)).collect()
+        }
+    }
+
+    pub fn type_info(&self, type_code: u32) -> Option<TypeInfo> {
+        let mut name: *const c_char = std::ptr::null();
+        let mut size: size_t = 0;
+        let mut flags: c_uint = 0;
+        unsafe {
+            if (self.CTITypeGetInfo)(type_code, &mut name, &mut size, &mut flags) != 0 {
+                return None;
+            }
+            Some(TypeInfo { code: type_code, name: CStr::from_ptr(name).to_str().unwrap().to_owned(), size, refcounted: flags & 1 != 0 })
+        }
+    }
+
+    pub fn type_code(&self, name: &str) -> Option<u32> {
+        self.type_list().into_iter().find(|t| t.name == name).map(|t| t.code)
+    }
+
+    /// Takes a reference to a refcounted ext value, see impl_packed_ext!(.., object).
+    pub fn object_retain(&self, handle: HandleType) {
+        unsafe {
+            (self.CTIObjectRetain)(handle);
+        }
+    }
+
+    pub fn object_release(&self, handle: HandleType) {
+        unsafe {
+            (self.CTIObjectRelease)(handle);
+        }
+    }
+
+    /// Looks up a function without allocating, the result has no name.
+    pub fn registry_get_cstr<'lib>(&'lib self, tag: &CStr, name: &CStr) -> PackedFunc<'lib> {
+        let mut handle: FuncHandle = std::ptr::null();
+        unsafe {
+            (self.CTIRegistryGet)(tag.as_ptr(), name.as_ptr(), &mut handle);
+        }
+        PackedFunc { name: None, handle, lib: self }
+    }
+
+    pub fn registry_get_typed<'lib, A: RawArgs, R>(&'lib self, tag: &CStr, name: &CStr) -> TypedPackedFunc<'lib, A, R> {
+        self.registry_get_cstr(tag, name).typed()
+    }
+
     pub fn registry_get(&self, tag: &str, name: &str) -> PackedFunc {
         let _tag = CString::new(tag).unwrap();
         let _name = CString::new(name).unwrap();
@@ -374,26 +1079,315 @@ impl Lib {
         PackedFunc { name: Some(String::from(name)), handle, lib: self }
     }
 
-    pub unsafe fn func_call(&self, func: FuncHandle, args: Vec<ManagedPackedArg>) -> PackedArg {
-        let num_args = args.len();
-        let mut type_codes = Vec::new();
-        let mut values = Vec::new();
+    pub unsafe fn func_call(&self, func: FuncHandle, args: Vec<ManagedPackedArg>) -> PackedArg<'_> {
         let mut ret_type: _PackedType = 0;
         let mut ret_val = _PackedValue { v_int64: 0 };
-        for arg in args.iter() {
-            let _arg = arg.to_raw();
-            type_codes.push(_arg.type_code);
-            values.push(_arg.value);
-        }
-        (self.CTIPackedFuncCall)(func, num_args, type_codes.as_ptr(), values.as_ptr(), &mut ret_type, &mut ret_val);
+        with_raw_args(&args, |type_codes, values| {
+            (self.CTIPackedFuncCall)(func, values.len(), type_codes.as_ptr(), values.as_ptr(), &mut ret_type, &mut ret_val);
+        });
         PackedArg::from_raw(&self,ret_type, ret_val)
     }
+
+    pub unsafe fn func_call_owned(&self, func: FuncHandle, args: Vec<ManagedPackedArg>) -> RetValue {
+        let mut ret = RetValue { handle: std::ptr::null_mut(), type_code: 0, value: _PackedValue { v_int64: 0 }, lib: self };
+        with_raw_args(&args, |type_codes, values| {
+            (self.CTIPackedFuncCallOwned)(func, values.len(), type_codes.as_ptr(), values.as_ptr(),
+                                          &mut ret.handle, &mut ret.type_code, &mut ret.value);
+        });
+        ret
+    }
+
+    pub unsafe fn func_call_batch(&self, func: FuncHandle, rows: Vec<Vec<ManagedPackedArg>>) -> Vec<PackedArg> {
+        let num_calls = rows.len();
+        let num_args = rows.first().map_or(0, |row| row.len());
+        let mut type_codes = Vec::with_capacity(num_calls * num_args);
+        let mut values = Vec::with_capacity(num_calls * num_args);
+        for row in rows.iter() {
+            assert_eq!(row.len(), num_args);
+            for arg in row.iter() {
+                let _arg = arg.to_raw();
+                type_codes.push(_arg.type_code);
+                values.push(_arg.value);
+            }
+        }
+        let mut ret_types: Vec<_PackedType> = vec![0; num_calls];
+        let mut ret_vals = vec![_PackedValue { v_int64: 0 }; num_calls];
+        (self.CTIPackedFuncCallBatch)(func, num_calls, num_args, type_codes.as_ptr(), values.as_ptr(),
+                                      ret_types.as_mut_ptr(), ret_vals.as_mut_ptr());
+        ret_types.into_iter().zip(ret_vals.into_iter()).map(|(t, v)| PackedArg::from_raw(&self, t, v)).collect()
+    }
 }
 
 impl<'lib> PackedFunc<'lib> {
-    pub unsafe fn call(&self, args: Vec<ManagedPackedArg<'lib>>) -> PackedArg<'lib> {
+    pub unsafe fn call(&self, args: Vec<ManagedPackedArg>) -> PackedArg<'lib> {
         self.lib.func_call(self.handle, args)
     }
+
+    pub unsafe fn call_owned(&self, args: Vec<ManagedPackedArg>) -> RetValue<'lib> {
+        self.lib.func_call_owned(self.handle, args)
+    }
+
+    pub unsafe fn call_async(&self, queue: &mut CompletionQueue<'lib>, args: Vec<ManagedPackedArg<'lib>>) -> u64 {
+        queue.submit(self, args)
+    }
+
+    pub unsafe fn call_batch(&self, rows: Vec<Vec<ManagedPackedArg>>) -> Vec<PackedArg<'lib>> {
+        self.lib.func_call_batch(self.handle, rows)
+    }
+
+    /// The same function called through a fixed signature, see TypedPackedFunc.
+    pub fn typed<A: RawArgs, R>(&self) -> TypedPackedFunc<'lib, A, R> {
+        TypedPackedFunc { handle: self.handle, lib: self.lib, signature: PhantomData }
+    }
+}
+
+impl<'lib, A: RawArgs, R: RawRet<'lib>> TypedPackedFunc<'lib, A, R> {
+    #[inline]
+    pub unsafe fn call(&self, args: A) -> R {
+        let values = args.to_raw_values();
+        let values = values.as_ref();
+        let mut ret_type: _PackedType = 0;
+        let mut ret_val = _PackedValue { v_int64: 0 };
+        (self.lib.CTIPackedFuncCall)(self.handle, values.len(), A::CODES.as_ptr(), values.as_ptr(), &mut ret_type, &mut ret_val);
+        R::from_raw_ret(self.lib, ret_type, ret_val)
+    }
+}
+
+impl<'lib, A, R> Debug for TypedPackedFunc<'lib, A, R> {
+    fn fmt(&self, f: &mut std::fmt::Formatter) -> std::fmt::Result {
+        write!(f, "TypedPackedFunc {{ handle: {:?} }}", self.handle)
+    }
+}
+
+impl<'lib> RetValue<'lib> {
+    #[inline]
+    pub fn type_code(&self) -> _PackedType {
+        self.type_code
+    }
+
+    /// Converts the native value, which stays owned by self. Strings, vectors and tensors are copied,
+    /// the as_* views borrow them instead.
+    pub fn get(&self) -> PackedArg<'lib> {
+        unsafe { PackedArg::from_raw(self.lib, self.type_code, self.value) }
+    }
+
+    pub fn as_cstr(&self) -> Option<&CStr> {
+        if self.type_code != PackedTypeCode::Str as _PackedType {
+            return None;
+        }
+        unsafe { Some(CStr::from_ptr(self.value.v_str)) }
+    }
+
+    pub fn as_bytes(&self) -> Option<&[u8]> {
+        if self.type_code != PackedTypeCode::Bytes as _PackedType {
+            return None;
+        }
+        unsafe {
+            let bytes = &*(self.value.v_ptr as *const _PackedBytes);
+            Some(if bytes.size == 0 { &[] } else { slice::from_raw_parts(bytes.data, bytes.size) })
+        }
+    }
+
+    /// A vector of kInt64 or a compact int64 tensor, flattened.
+    pub fn as_i64_slice(&self) -> Option<&[i64]> {
+        self.as_numeric_slice(PackedTypeCode::Int64)
+    }
+
+    /// A vector of kFloat64 or a compact float64 tensor, flattened.
+    pub fn as_f64_slice(&self) -> Option<&[f64]> {
+        self.as_numeric_slice(PackedTypeCode::Float64)
+    }
+
+    pub fn as_tensor<'a>(&'a self) -> Option<TensorView<'a>> {
+        if self.type_code != PackedTypeCode::Tensor as _PackedType && self.type_code != PackedTypeCode::MappedFile as _PackedType {
+            return None;
+        }
+        unsafe {
+            let t = &*(self.value.v_ptr as *const _PackedTensor);
+            let shape = if t.ndim == 0 { &[][..] } else { slice::from_raw_parts(t.shape, t.ndim as usize) };
+            let strides = if t.strides.is_null() { None } else { Some(slice::from_raw_parts(t.strides, t.ndim as usize)) };
+            Some(TensorView { dtype: t.dtype, shape, strides, data: t.data })
+        }
+    }
+
+    // values of a numeric kVector are laid out as T, the union being as wide as both element types
+    fn as_numeric_slice<T: DType>(&self, element: PackedTypeCode) -> Option<&[T]> {
+        if self.type_code == PackedTypeCode::Tensor as _PackedType {
+            return self.as_tensor().and_then(|t| t.as_slice::<T>());
+        }
+        if self.type_code != PackedTypeCode::Vector as _PackedType {
+            return None;
+        }
+        unsafe {
+            let vec = &*self.value.v_vec;
+            if vec.size == 0 {
+                return Some(&[]);
+            }
+            if vec.type_code != element as _PackedType || std::mem::size_of::<T>() != std::mem::size_of::<_PackedValue>() {
+                return None;
+            }
+            Some(slice::from_raw_parts(vec.data as *const T, vec.size))
+        }
+    }
+}
+
+impl<'a> TensorView<'a> {
+    pub fn size(&self) -> usize {
+        self.shape.iter().product::<i64>() as usize
+    }
+
+    pub fn is_compact(&self) -> bool {
+        match self.strides {
+            None => true,
+            Some(strides) => {
+                let mut expected = 1;
+                for (&n, &stride) in self.shape.iter().zip(strides.iter()).rev() {
+                    if n != 1 && stride != expected {
+                        return false;
+                    }
+                    expected *= n;
+                }
+                true
+            },
+        }
+    }
+
+    /// The elements in row-major order, None if the tensor is strided or T does not match dtype.
+    pub fn as_slice<T: DType>(&self) -> Option<&'a [T]> {
+        if self.dtype != T::DTYPE || !self.is_compact() {
+            return None;
+        }
+        if self.size() == 0 {
+            return Some(&[]);
+        }
+        unsafe { Some(slice::from_raw_parts(self.data as *const T, self.size())) }
+    }
+}
+
+impl<'lib> Drop for RetValue<'lib> {
+    fn drop(&mut self) {
+        if !self.handle.is_null() {
+            unsafe { (self.lib.CTIRetValueRelease)(self.handle); }
+            self.handle = std::ptr::null_mut();
+        }
+    }
+}
+
+impl<'lib> Iterator for PackedStream<'lib> {
+    type Item = PackedArg<'lib>;
+
+    fn next(&mut self) -> Option<PackedArg<'lib>> {
+        if self.handle.is_null() {
+            return None;
+        }
+        let mut has_next: c_int = 0;
+        let mut ret_type: _PackedType = 0;
+        let mut ret_val = _PackedValue { v_int64: 0 };
+        unsafe {
+            (self.lib.CTIStreamNext)(self.handle, &mut has_next, &mut ret_type, &mut ret_val);
+            if has_next == 0 {
+                return None;
+            }
+            Some(PackedArg::from_raw(self.lib, ret_type, ret_val))
+        }
+    }
+}
+
+impl<'lib> Drop for PackedStream<'lib> {
+    fn drop(&mut self) {
+        if !self.handle.is_null() {
+            unsafe { (self.lib.CTIStreamClose)(self.handle); }
+            self.handle = std::ptr::null_mut();
+        }
+    }
+}
+
+impl<'lib> MappedFile<'lib> {
+    /// Maps the file at path as elements of T, None if it could not be mapped.
+    pub fn open<T: DType>(lib: &'lib Lib, path: &str) -> Option<Self> {
+        let _path = CString::new(path).unwrap();
+        let mut handle: MappedFileHandle = std::ptr::null_mut();
+        unsafe {
+            if (lib.CTIMappedFileOpen)(_path.as_ptr(), T::DTYPE, &mut handle) != 0 {
+                return None;
+            }
+        }
+        Some(MappedFile { handle, lib })
+    }
+
+    fn tensor(&self) -> &_PackedTensor {
+        // the native MappedFile starts with its tensor
+        unsafe { &*(self.handle as *const _PackedTensor) }
+    }
+
+    pub fn len(&self) -> usize {
+        unsafe { *self.tensor().shape as usize }
+    }
+
+    /// The mapped elements, T should match the dtype the file was opened with.
+    pub fn as_slice<T: DType>(&self) -> &[T] {
+        let t = self.tensor();
+        assert_eq!(t.dtype, T::DTYPE);
+        if self.len() == 0 {
+            return &[];
+        }
+        unsafe { slice::from_raw_parts(t.data as *const T, self.len()) }
+    }
+}
+
+impl<'lib> Drop for MappedFile<'lib> {
+    fn drop(&mut self) {
+        if !self.handle.is_null() {
+            unsafe { (self.lib.CTIMappedFileRelease)(self.handle); }
+            self.handle = std::ptr::null_mut();
+        }
+    }
+}
+
+impl<'lib> CompletionQueue<'lib> {
+    pub fn new(lib: &'lib Lib) -> Self {
+        let mut handle: CompletionQueueHandle = std::ptr::null_mut();
+        unsafe {
+            (lib.CTICompletionQueueCreate)(&mut handle);
+        }
+        CompletionQueue { handle, pending: HashMap::new(), lib }
+    }
+
+    pub unsafe fn submit(&mut self, func: &PackedFunc<'lib>, args: Vec<ManagedPackedArg<'lib>>) -> u64 {
+        let mut ticket: u64 = 0;
+        with_raw_args(&args, |type_codes, values| {
+            (self.lib.CTIPackedFuncCallAsync)(func.handle, values.len(), type_codes.as_ptr(), values.as_ptr(), self.handle, &mut ticket);
+        });
+        self.pending.insert(ticket, args);
+        ticket
+    }
+
+    /// Waits up to timeout_ms (forever if negative) for a completed call, None at once if no call is pending.
+    pub fn wait(&mut self, timeout_ms: i64) -> Option<(u64, RetValue<'lib>)> {
+        let mut ready: c_int = 0;
+        let mut ticket: u64 = 0;
+        let mut ret = RetValue { handle: std::ptr::null_mut(), type_code: 0, value: _PackedValue { v_int64: 0 }, lib: self.lib };
+        unsafe {
+            (self.lib.CTICompletionQueueWait)(self.handle, timeout_ms, &mut ready, &mut ticket,
+                                              &mut ret.handle, &mut ret.type_code, &mut ret.value);
+        }
+        if ready == 0 {
+            return None;
+        }
+        self.pending.remove(&ticket);
+        Some((ticket, ret))
+    }
+
+    pub fn poll(&mut self) -> Option<(u64, RetValue<'lib>)> {
+        self.wait(0)
+    }
+}
+
+impl<'lib> Drop for CompletionQueue<'lib> {
+    fn drop(&mut self) {
+        unsafe { (self.lib.CTICompletionQueueFree)(self.handle); }
+        self.pending.clear();
+    }
 }
 
 impl Debug for Lib {
@@ -460,6 +1454,52 @@ macro_rules! impl_packed_ext {
     ( $n:ty, $c:expr, new = $new:expr, release = $release:expr ) => {
         impl_packed_ext!($n, $c);
         impl_packed_ext!($n, new = $new, release = $release );
+    };
+    // the native type derives ctypes::Object, every value holds a reference of its own
+    ( $n:ty, $c:expr, new = $new:expr, object ) => {
+        impl<'lib> PackedExt<'lib> for $n {
+            const CODE: u32 = $c;
+
+            fn from_raw(ptr: PackedArg<'lib>) -> Self {
+                let lib = ptr.lib();
+                let handle: HandleType = ptr.into();
+                lib.object_retain(handle);
+                Self{ handle, is_owned: true, lib }
+            }
+
+            fn new(lib: &'lib Lib) -> Self {
+                Self{ handle: Self::_new(lib), is_owned: true, lib }
+            }
+
+            fn release(&mut self) {
+                if self.is_owned {
+                    self._release();
+                    self.handle = std::ptr::null();
+                    self.is_owned = false;
+                }
+            }
+
+            fn is_owned(&self) -> bool { self.is_owned }
+            fn handle(&self) -> HandleType { self.handle }
+            fn lib(&self) -> &'lib Lib { self.lib }
+        }
+        impl<'lib> _PackedExt for $n {
+            fn _new(lib: &Lib) -> HandleType {
+                // the result only holds it until the next call
+                let handle: HandleType = packed_call!(lib.registry_get("PackedFunc", $new));
+                lib.object_retain(handle);
+                handle
+            }
+
+            fn _release(&self) {
+                self.lib.object_release(self.handle);
+            }
+        }
+        impl<'lib> Drop for $n {
+            fn drop(&mut self) {
+                self.release()
+            }
+        }
     }
 }
 
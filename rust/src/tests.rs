@@ -26,7 +26,9 @@ fn it_appends() {
     let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
     let append_str = lib.registry_get("PackedFunc", "append_str");
     let result_: String = packed_call!(append_str, "hello", "world");
-    println!("append_str: {}", result_);
+    let stats = lib.arena_stats();
+    println!("append_str: {}, arena: {:?}", result_, stats);
+    assert!(stats.used > 0);
 
     let test_append_str = lib.registry_get("PackedFunc", "test_append_str");
     let result: String = packed_call!(test_append_str, append_str, "append", "str");
@@ -41,4 +43,213 @@ fn it_list() {
     let result: Vec<Vec<i32>> = packed_call!(vector_add, vec!(vec!(1,2,3), vec!(4)), vec!(1,2,3,4));
     println!("vector_add: {:?}", result);
     assert_eq!(result, vec!(vec!(11,12,13), vec!(14)));
-}
\ No newline at end of file
+}
+#[test]
+fn it_batches() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let hello = lib.registry_get("PackedFunc", "hello");
+    let rows = (0..4).map(|i: i64| vec_packed_arg!(i, 10)).collect();
+    let result: Vec<i64> = unsafe { hello.call_batch(rows) }.into_iter().map(|x| x.into()).collect();
+    println!("hello batch: {:?}", result);
+    assert_eq!(result, vec!(10, 11, 12, 13));
+}
+
+#[test]
+fn it_owns() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let append_str = lib.registry_get("PackedFunc", "append_str");
+    let first = unsafe { append_str.call_owned(vec_packed_arg!("hello", "world")) };
+    let second = unsafe { append_str.call_owned(vec_packed_arg!("hello", "again")) };
+    let result: (String, String) = (first.get().into(), second.get().into());
+    println!("append_str owned: {:?}", result);
+    assert_eq!(result, (String::from("hello world"), String::from("hello again")));
+}
+
+#[test]
+fn it_runs_async() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let hello = lib.registry_get("PackedFunc", "hello");
+    let mut queue = CompletionQueue::new(&lib);
+    for i in 0..4i64 {
+        unsafe { hello.call_async(&mut queue, vec_packed_arg!(i, 100)) };
+    }
+    let mut result = Vec::new();
+    for _ in 0..4 {
+        let (ticket, ret) = queue.wait(-1).unwrap();
+        let value: i64 = ret.get().into();
+        result.push((ticket, value));
+    }
+    result.sort();
+    println!("hello async: {:?}", result);
+    assert_eq!(result, vec!((0, 100), (1, 101), (2, 102), (3, 103)));
+}
+
+#[test]
+fn it_maps_parallel() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let parallel_map = lib.registry_get("PackedFunc", "parallel_map");
+    let square = lib.registry_get("PackedFunc", "square");
+    let result: Vec<i64> = packed_call!(parallel_map, vec!(1i64, 2, 3, 4), square);
+    println!("parallel_map: {:?}, stats: {:?}", result, lib.parallel_stats());
+    assert_eq!(result, vec!(1, 4, 9, 16));
+}
+
+#[test]
+fn it_streams() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let range_stream = lib.registry_get("PackedFunc", "range_stream");
+    let stream: PackedStream = packed_call!(range_stream, 5, 2);
+    let result: Vec<Vec<i64>> = stream.map(|chunk| chunk.into()).collect();
+    println!("range_stream: {:?}", result);
+    assert_eq!(result, vec!(vec!(0, 1), vec!(2, 3), vec!(4)));
+}
+
+#[test]
+fn it_passes_tensors() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let tensor_sum = lib.registry_get("PackedFunc", "tensor_sum");
+    let tensor_scale = lib.registry_get("PackedFunc", "tensor_scale");
+    let t = Tensor::new(vec!(1f64, 2., 3., 4., 5., 6.), vec!(2, 3));
+    let sum: f64 = packed_call!(tensor_sum, &t);
+    let scaled: Tensor<f64> = packed_call!(tensor_scale, &t, 2.0);
+    println!("tensor_sum: {}, tensor_scale: {:?}", sum, scaled);
+    assert_eq!(sum, 21.0);
+    assert_eq!(scaled, Tensor::new(vec!(2., 4., 6., 8., 10., 12.), vec!(2, 3)));
+}
+
+#[test]
+fn it_passes_ragged() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let ragged_sums = lib.registry_get("PackedFunc", "ragged_sums");
+    let ragged_range = lib.registry_get("PackedFunc", "ragged_range");
+    let rows = Ragged::from(vec!(vec!(1i64, 2, 3), vec!(), vec!(4)));
+    let sums: Vec<i64> = packed_call!(ragged_sums, &rows);
+    let range: Ragged<i64> = packed_call!(ragged_range, 4);
+    println!("ragged_sums: {:?}, ragged_range: {:?}", sums, range);
+    assert_eq!(sums, vec!(6, 0, 4));
+    assert_eq!(range.row(3), &[0, 1, 2]);
+    assert_eq!(range, Ragged::from(vec!(vec!(), vec!(0i64), vec!(0, 1), vec!(0, 1, 2))));
+}
+
+#[test]
+fn it_passes_bytes() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let bytes_len = lib.registry_get("PackedFunc", "bytes_len");
+    let bytes_reverse = lib.registry_get("PackedFunc", "bytes_reverse");
+    let blob: &[u8] = b"a\0b\0c";
+    let len: i64 = packed_call!(bytes_len, blob);
+    let reversed: Bytes = packed_call!(bytes_reverse, blob);
+    println!("bytes_len: {}, bytes_reverse: {:?}", len, reversed);
+    assert_eq!(len, 5);
+    assert_eq!(reversed.0, b"c\0b\0a".to_vec());
+}
+
+#[test]
+fn it_maps_files() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let tensor_sum = lib.registry_get("PackedFunc", "tensor_sum");
+    let mmap_open = lib.registry_get("PackedFunc", "mmap_open");
+    let path = std::env::temp_dir().join("cti_it_maps_files.bin");
+    let data: Vec<u8> = [1f64, 2., 3., 4.].iter().flat_map(|x| x.to_ne_bytes().to_vec()).collect();
+    std::fs::write(&path, &data).unwrap();
+    let mapped = MappedFile::open::<f64>(&lib, path.to_str().unwrap()).unwrap();
+    let sum: f64 = packed_call!(tensor_sum, &mapped);
+    println!("mmap tensor_sum: {}", sum);
+    assert_eq!(sum, 10.0);
+    assert_eq!(mapped.as_slice::<f64>(), &[1., 2., 3., 4.]);
+    let returned: MappedFile = packed_call!(mmap_open, path.to_str().unwrap(), 2, 64);
+    assert_eq!(returned.len(), 4);
+    std::fs::remove_file(&path).unwrap();
+}
+
+#[test]
+fn it_lists_types() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let types = lib.type_list();
+    println!("types: {:?}", types);
+    for t in types.iter().filter(|t| t.code < 32) {
+        assert_eq!(format!("k{:?}", PackedTypeCode::from(t.code)), t.name);
+    }
+    assert_eq!(lib.type_code("kTensor"), Some(PackedTypeCode::Tensor as u32));
+    assert!(lib.type_info(1000).is_none());
+}
+
+#[test]
+fn it_calls_typed() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let tag = CStr::from_bytes_with_nul(b"PackedFunc\0").unwrap();
+    let hello: TypedPackedFunc<(i64, i64), i64> = lib.registry_get_typed(tag, CStr::from_bytes_with_nul(b"hello\0").unwrap());
+    assert_eq!(unsafe { hello.call((1, 2)) }, 3);
+    let append_str = lib.registry_get("PackedFunc", "append_str");
+    let (a, b) = (CString::new("typed").unwrap(), CString::new("call").unwrap());
+    let typed_append_str = append_str.typed::<(&CStr, &CStr), String>();
+    let result: String = unsafe { typed_append_str.call((&a, &b)) };
+    let test_append_str: TypedPackedFunc<(&PackedFunc, &CStr, &CStr), PackedArg> = lib.registry_get("PackedFunc", "test_append_str").typed();
+    let nested: String = unsafe { test_append_str.call((&append_str, &a, &b)) }.into();
+    println!("typed: {:?} {} {}", hello, result, nested);
+    assert_eq!(result, "typed call");
+    assert_eq!(nested, "typed call");
+}
+
+#[test]
+fn it_views_results() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let append_str = lib.registry_get("PackedFunc", "append_str");
+    let bytes_reverse = lib.registry_get("PackedFunc", "bytes_reverse");
+    let ragged_sums = lib.registry_get("PackedFunc", "ragged_sums");
+    let vec_mul = lib.registry_get("PackedFunc", "vec_mul");
+    let tensor_scale = lib.registry_get("PackedFunc", "tensor_scale");
+    let blob: &[u8] = b"ab\0c";
+    let t = Tensor::new(vec!(1f64, 2., 3., 4.), vec!(2, 2));
+    let s = unsafe { append_str.call_owned(vec_packed_arg!("hello", "view")) };
+    let b = unsafe { bytes_reverse.call_owned(vec_packed_arg!(blob)) };
+    let sums = unsafe { ragged_sums.call_owned(vec_packed_arg!(&Ragged::from(vec!(vec!(1i64, 2), vec!(3))))) };
+    let products = unsafe { vec_mul.call_owned(vec_packed_arg!(vec!(1f64, 2.), vec!(3f64, 4.))) };
+    let scaled = unsafe { tensor_scale.call_owned(vec_packed_arg!(&t, 0.5)) };
+    println!("views: {:?} {:?} {:?} {:?} {:?}", s.as_cstr(), b.as_bytes(), sums.as_i64_slice(), products.as_f64_slice(), scaled.as_tensor());
+    assert_eq!(s.as_cstr().unwrap().to_str().unwrap(), "hello view");
+    assert_eq!(b.as_bytes().unwrap(), b"c\0ba");
+    assert_eq!(sums.as_i64_slice().unwrap(), &[3, 3]);
+    assert!(sums.as_f64_slice().is_none());
+    assert_eq!(products.as_f64_slice().unwrap(), &[3., 8.]);
+    assert_eq!(scaled.as_tensor().unwrap().shape, &[2, 2]);
+    assert_eq!(scaled.as_f64_slice().unwrap(), &[0.5, 1., 1.5, 2.]);
+    assert!(s.as_bytes().is_none());
+}
+
+#[test]
+fn it_counts_calls() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let vec_fma = lib.registry_get("PackedFunc", "vec_fma");
+    lib.registry_stats_reset("PackedFunc", Some("vec_fma"));
+    assert!(lib.registry_stats_enable(true));
+    for _ in 0..3 {
+        let _: Vec<i64> = packed_call!(vec_fma, vec!(1i64, 2), vec!(3i64, 4), vec!(5i64, 6));
+    }
+    lib.registry_stats_enable(false);
+    let _: Vec<i64> = packed_call!(vec_fma, vec!(1i64), vec!(3i64), vec!(5i64));
+    let stats = lib.registry_stats("PackedFunc", "vec_fma").unwrap();
+    println!("stats: {:?}, mean_ns: {}", stats, stats.mean_ns());
+    assert_eq!(stats.calls, 3);
+    assert_eq!(stats.histogram.iter().sum::<u64>(), 3);
+    assert_eq!(stats.ret_bytes, 3 * 2 * 8);
+    assert!(lib.registry_stats("PackedFunc", "no_such_func").is_none());
+}
+
+#[test]
+fn it_traces_calls() {
+    let lib: Lib = Lib::open(_find_lib().as_ref()).unwrap();
+    let append_str = lib.registry_get("PackedFunc", "append_str");
+    let test_append_str = lib.registry_get("PackedFunc", "test_append_str");
+    let path = std::env::temp_dir().join("cti_it_traces_calls.json");
+    assert!(lib.trace_start(0));
+    let result: String = packed_call!(test_append_str, append_str, "trace", "me");
+    lib.trace_stop();
+    let dropped = lib.trace_dump(path.to_str().unwrap()).unwrap();
+    let json = std::fs::read_to_string(&path).unwrap();
+    std::fs::remove_file(&path).unwrap();
+    println!("trace: {}, dropped: {}", result, dropped);
+    assert!(json.contains("\"name\":\"test_append_str\""));
+    assert!(json.contains("\"type_codes\":[5,4,4]"));
+    assert_eq!(dropped, 0);
+}
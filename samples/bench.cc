@@ -0,0 +1,180 @@
+#include "api.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "packedfunc.h"
+#include "ext.h"
+
+using namespace ctypes;
+
+static auto &packedfunc_bench_add = Registry<PackedFunc>::Register("bench_add")
+    .set_body([](PackedFunc::Args args, PackedFunc::RetValue *rv) {
+      rv->reset(([](int64_t a, int64_t b) -> int64_t { return a+b; }) (args[0], args[1]));
+    });
+
+static auto &packedfunc_bench_add_typed = Registry<PackedFunc>::Register("bench_add_typed")
+    .set_typed_body([](int64_t a, int64_t b) -> int64_t { return a+b; });
+
+static auto &packedfunc_bench_vec_add = Registry<PackedFunc>::Register("bench_vec_add")
+    .set_elementwise_body(ops::Add<double>{});
+
+// the same fields are written by python/samples/bench.py and rust/samples/bench.rs
+struct BenchResult {
+  std::string api;
+  std::string kind;
+  size_t iterations;
+  double ns_per_call;
+};
+
+static std::vector<BenchResult> results;
+static uint64_t checksum = 0;
+
+template <typename F>
+static double bench(const std::string& api, const std::string& kind, size_t n, F&& f) {
+  for (size_t i = 0; i < n / 10; i++) {
+    f(i);
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; i++) {
+    f(i);
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  double ns = elapsed.count() / n;
+  std::cout << api << " " << kind << ": " << ns << " ns/call" << std::endl;
+  results.push_back(BenchResult{api, kind, n, ns});
+  return ns;
+}
+
+// copies the arguments into a heap vector first, as Args did before it became a view
+static void FuncCallCopy(const void* handle, size_t num_args, const PackedType* type_codes, const PackedValue* values, PackedType* ret_type, PackedValue* ret_val) {
+  std::vector<PackedFunc::Arg> copied;
+  for (size_t i = 0; i < num_args; i++) {
+    copied.emplace_back(type_codes[i], values[i]);
+  }
+  PackedFunc::FuncCall(handle, copied.size(), type_codes, values, ret_type, ret_val);
+}
+
+// Times the bench_<kind> function of test_ctypes called directly and through the C API,
+// args are packed once so only the call itself is measured.
+template <typename... ArgTps>
+static void bench_kind(const std::string& kind, size_t n, const ArgTps&... args) {
+  const std::string name = "bench_" + kind;
+  const PackedFunc* f = Registry<PackedFunc>::Get(name);
+  bench("PackedFunc::operator()", kind, n, [&](size_t) {
+    PackedFunc::RetValue rv = f->operator()(args...);
+    checksum += rv.value().v_int64;
+  });
+  func_handle handle;
+  CTIRegistryGet("PackedFunc", name.c_str(), &handle);
+  const std::array<PackedFunc::Arg, sizeof...(ArgTps)> packed_args{ PackedFunc::Arg::from(args)... };
+  std::array<unsigned, sizeof...(ArgTps)> type_codes;
+  std::array<packedvalue_handle, sizeof...(ArgTps)> values;
+  for (size_t i = 0; i < packed_args.size(); i++) {
+    type_codes[i] = packed_args[i].type_code();
+    const PackedValue v = packed_args[i].value();
+    std::memcpy(&values[i], &v, sizeof(v));
+  }
+  unsigned ret_type;
+  packedvalue_handle ret_val;
+  bench("CTIPackedFuncCall", kind, n, [&](size_t) {
+    CTIPackedFuncCall(handle, values.size(), type_codes.data(), values.data(), &ret_type, &ret_val);
+    checksum += ret_val.v_int64;
+  });
+}
+
+static bool write_json(const std::string& path) {
+  std::ofstream o(path);
+  if (!o) {
+    std::cerr << "could not write " << path << std::endl;
+    return false;
+  }
+  o << "{\"lang\": \"cpp\", \"results\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult& r = results[i];
+    o << (i == 0 ? "\n" : ",\n") << "  {\"api\": \"" << r.api << "\", \"kind\": \"" << r.kind << "\", \"iterations\": " << r.iterations
+      << ", \"ns_per_call\": " << r.ns_per_call << ", \"calls_per_sec\": " << 1e9 / r.ns_per_call << "}";
+  }
+  o << "\n]}" << std::endl;
+  return bool(o);
+}
+
+// usage: bench [--json PATH] [--iterations N]
+int main(int argc, char** argv) {
+  size_t n = 1000000;
+  std::string json_path;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--json") == 0) {
+      json_path = argv[i + 1];
+    } else if (std::strcmp(argv[i], "--iterations") == 0) {
+      n = std::stoul(argv[i + 1]);
+    }
+  }
+
+  func_handle add;
+  CTIRegistryGet("PackedFunc", "bench_add", &add);
+  const unsigned type_codes[] = { PackedTypeCode::kInt64, PackedTypeCode::kInt64 };
+  packedvalue_handle values[2];
+  unsigned ret_type;
+  packedvalue_handle ret_val;
+
+  double copy_ns = bench("CTIPackedFuncCall (copied args)", "bench_add", n, [&](size_t i) {
+    values[0].v_int64 = i;
+    values[1].v_int64 = 1;
+    FuncCallCopy(add, 2, type_codes, reinterpret_cast<const PackedValue*>(values), &ret_type, reinterpret_cast<PackedValue*>(&ret_val));
+    checksum += ret_val.v_int64;
+  });
+  double view_ns = bench("CTIPackedFuncCall", "bench_add", n, [&](size_t i) {
+    values[0].v_int64 = i;
+    values[1].v_int64 = 1;
+    CTIPackedFuncCall(add, 2, type_codes, values, &ret_type, &ret_val);
+    checksum += ret_val.v_int64;
+  });
+  bench("PackedFunc::operator()", "bench_add", n, [&](size_t i) {
+    int64_t r = reinterpret_cast<const PackedFunc*>(add)->operator()(static_cast<int64_t>(i), 1);
+    checksum += r;
+  });
+  func_handle add_typed;
+  CTIRegistryGet("PackedFunc", "bench_add_typed", &add_typed);
+  bench("CTIPackedFuncCall", "bench_add_typed", n, [&](size_t i) {
+    values[0].v_int64 = i;
+    values[1].v_int64 = 1;
+    CTIPackedFuncCall(add_typed, 2, type_codes, values, &ret_type, &ret_val);
+    checksum += ret_val.v_int64;
+  });
+  const size_t column_size = 1 << 16;
+  auto column_a = PackedManagedVector::create(std::vector<double>(column_size, 1.5));
+  auto column_b = PackedManagedVector::create(std::vector<double>(column_size, 2.5));
+  const PackedFunc* vec_add = Registry<PackedFunc>::Get("bench_vec_add");
+  double scalar_ns = bench("PackedFunc::operator()", "bench_vec_add scalar", n, [&](size_t i) {
+    double r = vec_add->operator()(column_a.content.data[i % column_size].v_float64, column_b.content.data[i % column_size].v_float64);
+    checksum += static_cast<int64_t>(r);
+  });
+  double columnar_ns = bench("PackedFunc::operator()", "bench_vec_add column", n / 1000, [&](size_t i) {
+    auto rv = vec_add->operator()(column_a, column_b);
+    PackedVector r = rv;
+    checksum += static_cast<int64_t>(r.data[i % column_size].v_float64);
+  }) / column_size;
+  std::cout << "bench_vec_add columnar per element: " << columnar_ns << " ns (" << scalar_ns / columnar_ns << "x)" << std::endl;
+  std::cout << "args view speedup: " << copy_ns / view_ns << "x" << std::endl;
+
+  // one function per argument kind, shared with the Python and Rust benches
+  const PackedFunc* square = Registry<PackedFunc>::Get("square");
+  auto vector = PackedManagedVector::create(std::vector<double>(16, 0.5));
+  auto nested = PackedManagedVector::create(std::vector<std::vector<int64_t>>(4, std::vector<int64_t>(4, 1)));
+  ObjectRef<ext::test> object = make_object<ext::test>();
+  bench_kind("int64", n, int64_t(1), int64_t(2));
+  bench_kind("float64", n, 1.5, 2.0);
+  bench_kind("str", n, "hello");
+  bench_kind("func", n, *square);
+  bench_kind("vector", n, vector);
+  bench_kind("nested", n, nested);
+  bench_kind("ext", n, object.get());
+  std::cout << "checksum " << checksum << std::endl;
+
+  if (!json_path.empty() && !write_json(json_path)) {
+    return 1;
+  }
+  return 0;
+}
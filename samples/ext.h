@@ -5,7 +5,8 @@
 
 namespace ext {
 
-struct test {
+// refcounted, so it is shared instead of copied when returned
+struct test : ctypes::Object {
   std::string name = "run";
 };
 
@@ -1,47 +1,141 @@
 #include <iostream>
 #include <numeric>
+#include <cstdio>
+#include <sstream>
+#include <thread>
 #include "packedfunc.h"
+#include "mmap.h"
+#include "typeinfo.h"
 #include "ext.h"
 
 using namespace ctypes;
 
 static auto &packedfunc_hello = Registry<PackedFunc>::Register("hello")
-    .set_body([](PackedFunc::Args args, PackedFunc::RetValue *rv) {
-      rv->reset(([](int a, int b) -> int { return a+b; }) (args[0], args[1]));
-    });
+    .set_typed_body([](int a, int b) -> int { return a+b; });
 
+static auto &packedfunc_hello_int = Registry<PackedFunc>::Register("hello_int")
+    .set_typed_body([](int x) -> int64_t { return x; });
 
 static auto &packedfunc_append_str = Registry<PackedFunc>::Register("append_str")
-    .set_body([](PackedFunc::Args args, PackedFunc::RetValue *rv) {
-      rv->reset(([](std::string a, std::string b) -> std::string { return a+" "+b; }) (args[0], args[1]));
-    });
+    .set_typed_body([](std::string a, std::string b) -> std::string { return a+" "+b; });
 
 static auto &packedfunc_test_append_str = Registry<PackedFunc>::Register("test_append_str")
-    .set_body([](PackedFunc::Args args, PackedFunc::RetValue *rv) {
-      rv->reset(([](PackedFunc func, std::string a, std::string b) -> std::string { return func(a, b); }) (args[0], args[1], args[2]));
-    });
+    .set_typed_body([](PackedFunc func, std::string a, std::string b) -> std::string { return func(a, b); });
 
 static auto &packedfunc_vector_add = Registry<PackedFunc>::Register("vector_add")
-    .set_body([](PackedFunc::Args args, PackedFunc::RetValue *rv) {
-      rv->reset(([](std::vector<std::vector<int>> a, std::vector<int> b) -> std::vector<std::vector<int>> {
-        int t = std::accumulate(b.begin(), b.end(), 0);
-        for(auto& x: a){for(auto& i: x){i += t;};} return a;
-      }) (args[0], args[1]));
+    .set_typed_body([](std::vector<std::vector<int>> a, std::vector<int> b) -> std::vector<std::vector<int>> {
+      int t = std::accumulate(b.begin(), b.end(), 0);
+      for(auto& x: a){for(auto& i: x){i += t;};} return a;
     });
 
-static auto &packedfunc_ext_new = Registry<PackedFunc>::Register("ext_new")
-    .set_body([](PackedFunc::Args args, PackedFunc::RetValue *rv) {
-      ext::test* p = new ext::test;
-      std::cerr << "new ext::test " << p << std::endl;
-      rv->reset(p/*, false*/);
+static auto &packedfunc_vector_sum = Registry<PackedFunc>::Register("vector_sum")
+    .set_typed_body([](PackedVectorView<PackedVectorView<int64_t>> a) -> int64_t {
+      int64_t r = 0;
+      for (auto x : a) {
+        r = std::accumulate(x.begin(), x.end(), r);
+      }
+      return r;
     });
 
-static auto &packedfunc_ext_release = Registry<PackedFunc>::Register("ext_release")
+static auto &packedfunc_ragged_sums = Registry<PackedFunc>::Register("ragged_sums")
+    .set_typed_body([](PackedRagged a) -> std::vector<int64_t> {
+      std::vector<int64_t> r;
+      r.reserve(a.num_rows);
+      for (size_t i = 0; i < a.num_rows; i++) {
+        auto row = a.row_view<int64_t>(i);
+        r.push_back(std::accumulate(row.begin(), row.end(), int64_t(0)));
+      }
+      return r;
+    });
+
+static auto &packedfunc_ragged_range = Registry<PackedFunc>::Register("ragged_range")
+    .set_typed_body([](int64_t n) -> PackedManagedRagged {
+      PackedManagedRagged r(PackedTypeCode::kInt64);
+      std::vector<int64_t> row;
+      for (int64_t i = 0; i < n; i++) {
+        r.push_row(row.begin(), row.end());
+        row.push_back(i);
+      }
+      return r;
+    });
+
+static auto &packedfunc_bytes_len = Registry<PackedFunc>::Register("bytes_len")
+    .set_typed_body([](std::string_view a) -> int64_t { return a.size(); });
+
+static auto &packedfunc_bytes_reverse = Registry<PackedFunc>::Register("bytes_reverse")
+    .set_typed_body([](PackedBytes a) -> PackedManagedBytes {
+      std::string_view v = a.view();
+      return PackedManagedBytes(std::string(v.rbegin(), v.rend()));
+    });
+
+static auto &packedfunc_square = Registry<PackedFunc>::Register("square")
+    .set_typed_body([](int64_t x) -> int64_t { return x*x; });
+
+static auto &packedfunc_vec_mul = Registry<PackedFunc>::Register("vec_mul")
+    .set_elementwise_body(ops::Mul<double>{});
+
+static auto &packedfunc_vec_fma = Registry<PackedFunc>::Register("vec_fma")
+    .set_elementwise_body([](int64_t a, int64_t b, int64_t c) -> int64_t { return a*b+c; });
+
+static auto &packedfunc_vec_add_int = Registry<PackedFunc>::Register("vec_add_int")
+    .set_elementwise_body(ops::Add<int>{});
+
+static auto &packedfunc_range_stream = Registry<PackedFunc>::Register("range_stream")
+    .set_typed_body([](int64_t n, int64_t chunk) -> PackedStream* {
+      return new PackedStream([n, chunk, i = int64_t(0)](PackedFunc::RetValue *rv) mutable {
+        if (i >= n) {
+          return false;
+        }
+        std::vector<int64_t> r;
+        for (; i < n && static_cast<int64_t>(r.size()) < chunk; i++) {
+          r.push_back(i);
+        }
+        rv->reset(r);
+        return true;
+      });
+    });
+
+static auto &packedfunc_tensor_sum = Registry<PackedFunc>::Register("tensor_sum")
+    .set_typed_body([](PackedTensor t) -> double {
+      double r = 0;
+      if (t.dtype == PackedDType::of<int64_t>()) {
+        const int64_t* data = t.data_as<int64_t>();
+        for (size_t i = 0; i < t.size(); i++) {
+          r += data[t.offset(i)];
+        }
+      } else {
+        const double* data = t.data_as<double>();
+        for (size_t i = 0; i < t.size(); i++) {
+          r += data[t.offset(i)];
+        }
+      }
+      return r;
+    });
+
+static auto &packedfunc_tensor_scale = Registry<PackedFunc>::Register("tensor_scale")
+    .set_typed_body([](PackedTensor t, double k) -> PackedManagedTensor {
+      PackedManagedTensor r(PackedDType::of<double>(), std::vector<int64_t>(t.shape, t.shape + t.ndim));
+      const double* data = t.data_as<double>();
+      double* out = r.data<double>();
+      for (size_t i = 0; i < t.size(); i++) {
+        out[i] = data[t.offset(i)] * k;
+      }
+      return r;
+    });
+
+static auto &packedfunc_vector_dot = Registry<PackedFunc>::Register("vector_dot")
+    .set_typed_body([](PackedVectorView<double> a, PackedVectorView<double> b) -> double {
+      CHECK_EQ(a.size(), b.size());
+      return std::inner_product(a.begin(), a.end(), b.begin(), 0.0);
+    });
+
+static auto &typeinfo_ext_test = Registry<TypeInfo>::Register("ext::test").set_type<ext::test>();
+
+static auto &packedfunc_ext_new = Registry<PackedFunc>::Register("ext_new")
     .set_body([](PackedFunc::Args args, PackedFunc::RetValue *rv) {
-      ext::test* p = args[0];
-      std::cerr << "release ext::test " << p << std::endl;
-      delete p;
-      rv->reset(0);
+      ObjectRef<ext::test> p = make_object<ext::test>();
+      std::cerr << "new ext::test " << p.get() << std::endl;
+      rv->reset(std::move(p));
     });
 
 static auto &packedfunc_ext_get = Registry<PackedFunc>::Register("ext_get")
@@ -78,6 +172,16 @@ int test_packedfunc() {
   int hello_result = Registry<PackedFunc>::Get("hello")->operator()(1, 2);
   std::cout << "hello: 1+2=" << hello_result << std::endl;
 
+  // an int64 that does not fit the int parameter is reported
+  std::ostringstream log;
+  std::streambuf* cerr_buf = std::cerr.rdbuf(log.rdbuf());
+  Registry<PackedFunc>::Get("hello_int")->operator()(int64_t(1) << 40);
+  std::cerr.rdbuf(cerr_buf);
+  CHECK(log.str().find("get 1099511627776 out of range") != std::string::npos) << log.str();
+  // C callers pass no type codes without arguments
+  std::vector<int64_t> stats = Registry<PackedFunc>::Get("parallel_stats")->call_packed(PackedFunc::Args(0, nullptr, nullptr));
+  CHECK_EQ(stats.size(), 4u);
+
   return 0;
 }
 
@@ -88,6 +192,20 @@ int test_str() {
   return 0;
 }
 
+int test_bytes() {
+  const std::string blob("a\0b\0c", 5);
+  PackedBytes bytes{blob.data(), blob.size()};
+  int64_t len = Registry<PackedFunc>::Get("bytes_len")->operator()(bytes);
+  int64_t str_len = Registry<PackedFunc>::Get("bytes_len")->operator()("hello");
+  PackedFunc::RetValue reversed = Registry<PackedFunc>::Get("bytes_reverse")->operator()(bytes);
+  std::string_view r = reversed;
+  CHECK_EQ(len, 5);
+  CHECK_EQ(str_len, 5);
+  CHECK(r == std::string_view("c\0b\0a", 5));
+  std::cout << "bytes_len: " << len << ", bytes_reverse: " << r.size() << " bytes" << std::endl;
+  return 0;
+}
+
 int test_func() {
   std::string hello_result = Registry<PackedFunc>::Get("test_append_str")->operator()(*Registry<PackedFunc>::Get("append_str"), "append", "str");
   std::cout << "test_append_str: " << hello_result << std::endl;
@@ -109,20 +227,217 @@ int test_vector() {
   }
   std::cout << "]" << std::endl;
 
+  int64_t sum_result = Registry<PackedFunc>::Get("vector_sum")->operator()(
+      PackedManagedVector::create(std::vector<std::vector<int64_t>>{{1, 2, 3}, {}, {4}}));
+  CHECK_EQ(sum_result, 10);
+  std::cout << "vector_sum: " << sum_result << std::endl;
+
+  std::vector<int64_t> ragged_result = Registry<PackedFunc>::Get("ragged_sums")->operator()(
+      PackedManagedRagged::create(std::vector<std::vector<int64_t>>{{1, 2, 3}, {}, {4}}));
+  PackedFunc::RetValue range_result = Registry<PackedFunc>::Get("ragged_range")->operator()(4);
+  PackedRagged range = range_result;
+  CHECK_EQ(range.num_rows, 4u);
+  CHECK_EQ(range.size(), 6u);
+  std::cout << "ragged_sums: [";
+  for (auto i : ragged_result) {
+    std::cout << i << ",";
+  }
+  std::cout << "], ragged_range: [";
+  for (size_t i = 0; i < range.num_rows; i++) {
+    std::cout << "[";
+    for (auto x : range.row_view<int64_t>(i)) {
+      std::cout << x << ",";
+    }
+    std::cout << "], ";
+  }
+  std::cout << "]" << std::endl;
+
+  return 0;
+}
+
+int test_elementwise() {
+  double scalar_result = Registry<PackedFunc>::Get("vec_mul")->operator()(1.5, 2.0);
+  std::vector<int64_t> fma_result = Registry<PackedFunc>::Get("vec_fma")->operator()(
+      PackedManagedVector::create(std::vector<int64_t>{1, 2, 3}),
+      PackedManagedVector::create(std::vector<int64_t>{4, 5, 6}),
+      PackedManagedVector::create(std::vector<int64_t>{1, 1, 1}));
+  // empty columns need no element type
+  std::vector<int64_t> empty_result = Registry<PackedFunc>::Get("vec_fma")->operator()(
+      PackedManagedVector(PackedTypeCode::kUnknown, {}), PackedManagedVector(PackedTypeCode::kUnknown, {}),
+      PackedManagedVector(PackedTypeCode::kUnknown, {}));
+  CHECK(empty_result.empty());
+  // columns are narrowed with the same range check as scalars
+  std::ostringstream log;
+  std::streambuf* cerr_buf = std::cerr.rdbuf(log.rdbuf());
+  Registry<PackedFunc>::Get("vec_add_int")->operator()(
+      PackedManagedVector::create(std::vector<int64_t>{int64_t(1) << 40}), PackedManagedVector::create(std::vector<int64_t>{1}));
+  std::cerr.rdbuf(cerr_buf);
+  CHECK(log.str().find("out of range") != std::string::npos) << log.str();
+  std::cout << "vec_mul: " << scalar_result << ", vec_fma: [";
+  for (auto i : fma_result) {
+    std::cout << i << ",";
+  }
+  std::cout << "]" << std::endl;
+  return 0;
+}
+
+int test_parallel() {
+  std::atomic<int64_t> sum{0};
+  PackedFunc body([&sum](PackedFunc::Args args, PackedFunc::RetValue *rv) {
+    sum += args[0].operator int64_t();
+    rv->reset(0);
+  });
+  Registry<PackedFunc>::Get("parallel_for")->operator()(1000, body);
+  Registry<PackedFunc>::Get("parallel_for")->operator()(0, body);
+  // a negative count runs nothing
+  std::ostringstream log;
+  std::streambuf* cerr_buf = std::cerr.rdbuf(log.rdbuf());
+  Registry<PackedFunc>::Get("parallel_for")->operator()(-1, body);
+  std::cerr.rdbuf(cerr_buf);
+  CHECK(log.str().find("is negative") != std::string::npos) << log.str();
+  std::vector<int64_t> squares = Registry<PackedFunc>::Get("parallel_map")->operator()(
+      PackedManagedVector::create(std::vector<int64_t>{1, 2, 3, 4}), *Registry<PackedFunc>::Get("square"));
+  std::vector<int64_t> stats = Registry<PackedFunc>::Get("parallel_stats")->operator()();
+  CHECK_EQ(sum.load(), 499500);
+  std::cout << "parallel_for: sum=" << sum << ", parallel_map: [";
+  for (auto i : squares) {
+    std::cout << i << ",";
+  }
+  std::cout << "], threads=" << stats[0] << std::endl;
+  return 0;
+}
+
+int test_stream() {
+  std::unique_ptr<PackedStream> stream(Registry<PackedFunc>::Get("range_stream")->operator()(5, 2).operator PackedStream*());
+  std::cout << "range_stream: [";
+  while (stream->next()) {
+    std::vector<int64_t> chunk = stream->current();
+    std::cout << "[";
+    for (auto i : chunk) {
+      std::cout << i << ",";
+    }
+    std::cout << "], ";
+  }
+  std::cout << "]" << std::endl;
+  return 0;
+}
+
+int test_tensor() {
+  PackedManagedTensor t = PackedManagedTensor::create(std::vector<double>{1, 2, 3, 4, 5, 6}, {2, 3});
+  double sum = Registry<PackedFunc>::Get("tensor_sum")->operator()(t);
+  PackedFunc::RetValue scaled = Registry<PackedFunc>::Get("tensor_scale")->operator()(t, 2.0);
+  PackedTensor s = scaled;
+  // column 1 of the 2x3 tensor through strides
+  const int64_t shape[] = {2};
+  const int64_t strides[] = {3};
+  PackedTensor column{t.data<double>() + 1, PackedDType::of<double>(), 1, shape, strides};
+  double column_sum = Registry<PackedFunc>::Get("tensor_sum")->operator()(column);
+  CHECK_EQ(sum, 21);
+  CHECK_EQ(column_sum, 7);
+  CHECK(!column.contiguous());
+  std::cout << "tensor_sum: " << sum << ", column: " << column_sum << ", tensor_scale: [";
+  for (size_t i = 0; i < s.size(); i++) {
+    std::cout << s.data_as<double>()[i] << ",";
+  }
+  std::cout << "], shape=(" << s.shape[0] << "," << s.shape[1] << ")" << std::endl;
+  // a compact 1-d tensor is read in place where a vector is expected
+  const int64_t flat_shape[] = {6};
+  PackedTensor flat{t.data<double>(), PackedDType::of<double>(), 1, flat_shape, nullptr};
+  double dot = Registry<PackedFunc>::Get("vector_dot")->operator()(
+      flat, PackedManagedVector::create(std::vector<double>{1, 1, 1, 0, 0, 0}));
+  CHECK_EQ(dot, 6);
+  // anything else is not viewed in place
+  CHECK(PackedVectorView<double>(column).empty() && PackedVectorView<double>(t.content).empty());
+  CHECK(PackedVectorView<int64_t>(flat).empty());
+  std::cout << "vector_dot: " << dot << std::endl;
+  return 0;
+}
+
+int test_mmap() {
+  const std::string path = "test_mmap.bin";
+  const double data[] = {1, 2, 3, 4};
+  std::FILE* f = std::fopen(path.c_str(), "wb");
+  CHECK(f != nullptr);
+  std::fwrite(data, sizeof(double), 4, f);
+  std::fclose(f);
+  MappedFile* file = Registry<PackedFunc>::Get("mmap_open")->operator()(path, int64_t(PackedDType::kFloat), int64_t(64));
+  MappedFile* empty_dtype = Registry<PackedFunc>::Get("mmap_open")->operator()(path, int64_t(PackedDType::kFloat), int64_t(0));
+  MappedFile* wide_dtype = Registry<PackedFunc>::Get("mmap_open")->operator()(path, int64_t(PackedDType::kFloat), int64_t(256));
+  MappedFile* no_lanes = MappedFile::Open(path, PackedDType{PackedDType::kFloat, 64, 0});
+  std::remove(path.c_str());
+  CHECK(file != nullptr);
+  CHECK(empty_dtype == nullptr && wide_dtype == nullptr && no_lanes == nullptr);
+  CHECK_EQ(file->content.shape[0], 4);
+  double sum = Registry<PackedFunc>::Get("tensor_sum")->operator()(file);
+  CHECK_EQ(sum, 10);
+  std::cout << "mmap tensor_sum: " << sum << std::endl;
+  Registry<PackedFunc>::Get("mmap_release")->operator()(file);
   return 0;
 }
 
 int test_ext() {
-  ext::test* t = Registry<PackedFunc>::Get("ext_new")->operator()();
-  ext::test* hello_result = Registry<PackedFunc>::Get("ext_transform")->operator()(t);
-  CHECK_EQ(t, hello_result);
+  ObjectRef<ext::test> t = Registry<PackedFunc>::Get("ext_new")->operator()();
+  CHECK_EQ(t->use_count(), 1);
+  {
+    ObjectRef<ext::test> hello_result = Registry<PackedFunc>::Get("ext_transform")->operator()(t);
+    CHECK_EQ(t.get(), hello_result.get());
+    CHECK_EQ(t->use_count(), 2);
+  }
+  CHECK_EQ(t->use_count(), 1);
   std::cout << "ext_transform: " << t->name << std::endl;
-  Registry<PackedFunc>::Get("ext_release")->operator()(t);
+  const TypeInfo* info = TypeInfo::Get(PackedTypeCode::TypeCode<ext::test>::code());
+  CHECK(info != nullptr && info->name == "ext::test");
+  CHECK(info->flags & TypeInfo::kRefcounted);
+  void* copy = info->copy(t.get());
+  CHECK_EQ(copy, static_cast<void*>(t.get()));
+  CHECK_EQ(t->use_count(), 2);
+  info->free(copy);
+  CHECK_EQ(TypeInfo::Get(PackedTypeCode::kTensor)->name, "kTensor");
+  return 0;
+}
+
+int test_freeze() {
+  Registry<PackedFunc>::Freeze();
+  CHECK(Registry<PackedFunc>::Frozen());
+  Registry<PackedFunc>::Register("hello_late")
+      .set_body([](PackedFunc::Args args, PackedFunc::RetValue *rv) {
+        rv->reset(0);
+      });
+  CHECK(Registry<PackedFunc>::Get("hello_late") != nullptr);
+  CHECK(Registry<PackedFunc>::Get("hello_missing") == nullptr);
+  // late entries are listed before a new generation is published
+  const auto names = Registry<PackedFunc>::ListNames();
+  CHECK(std::find(names.begin(), names.end(), "hello_late") != names.end());
+  // a name registered before a lookup starts is found even while other threads publish generations
+  constexpr int num_late = 256;
+  std::vector<std::atomic<bool>> registered(num_late);
+  std::atomic<int> misses{0};
+  std::thread writer([&registered]() {
+    for (int i = 0; i < num_late; i++) {
+      Registry<PackedFunc>::Register("hello_late_" + std::to_string(i)).set_typed_body([]() -> int { return 0; });
+      registered[i].store(true);
+    }
+  });
+  std::thread reader([&registered, &misses]() {
+    for (int i = 0; i < num_late; i++) {
+      while (!registered[i].load()) { }
+      const std::string name = "hello_late_" + std::to_string(i);
+      misses += Registry<PackedFunc>::Get(name) == nullptr;
+      if (i % 32 == 0) {
+        const auto late_names = Registry<PackedFunc>::ListNames();
+        misses += std::find(late_names.begin(), late_names.end(), name) == late_names.end();
+      }
+    }
+  });
+  writer.join();
+  reader.join();
+  CHECK_EQ(misses.load(), 0);
+  std::cout << "freeze: " << names.size() << " names" << std::endl;
   return 0;
 }
 
 int test_all() {
-  std::vector<std::function<int()>> ts = { test_packedfunc, test_str, test_func, test_vector, test_ext };
+  std::vector<std::function<int()>> ts = { test_packedfunc, test_str, test_bytes, test_func, test_vector, test_elementwise, test_parallel, test_stream, test_tensor, test_mmap, test_ext, test_freeze };
   std::vector<PackedFunc> packed_ts;
   std::transform(ts.begin(), ts.end(), std::back_inserter(packed_ts), [](auto f) -> PackedFunc{
     return PackedFunc{[f](PackedFunc::Args, PackedFunc::RetValue *rv) {
@@ -0,0 +1,35 @@
+#include <numeric>
+#include "packedfunc.h"
+#include "ext.h"
+
+using namespace ctypes;
+
+// One function per argument kind with a trivial body, so the benches in samples/bench.cc,
+// python/samples/bench.py and rust/samples/bench.rs time the crossing rather than the work.
+
+static auto &packedfunc_bench_int64 = Registry<PackedFunc>::Register("bench_int64")
+    .set_typed_body([](int64_t a, int64_t b) -> int64_t { return a + b; });
+
+static auto &packedfunc_bench_float64 = Registry<PackedFunc>::Register("bench_float64")
+    .set_typed_body([](double a, double b) -> double { return a * b; });
+
+static auto &packedfunc_bench_str = Registry<PackedFunc>::Register("bench_str")
+    .set_typed_body([](std::string_view s) -> int64_t { return s.size(); });
+
+static auto &packedfunc_bench_func = Registry<PackedFunc>::Register("bench_func")
+    .set_typed_body([](PackedFunc f) -> int64_t { return f.body_ != nullptr; });
+
+static auto &packedfunc_bench_vector = Registry<PackedFunc>::Register("bench_vector")
+    .set_typed_body([](PackedVectorView<double> v) -> double { return std::accumulate(v.begin(), v.end(), 0.0); });
+
+static auto &packedfunc_bench_nested = Registry<PackedFunc>::Register("bench_nested")
+    .set_typed_body([](std::vector<std::vector<int64_t>> v) -> int64_t {
+      int64_t r = 0;
+      for (const auto& i : v) {
+        r += i.size();
+      }
+      return r;
+    });
+
+static auto &packedfunc_bench_ext = Registry<PackedFunc>::Register("bench_ext")
+    .set_typed_body([](ext::test* p) -> int64_t { return p->name.size(); });
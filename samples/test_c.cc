@@ -3,6 +3,9 @@
 #include <string>
 #include <algorithm>
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <fstream>
 #include "packedfunc.h"
 
 namespace ctypes {
@@ -31,7 +34,9 @@ struct PackedFunc {
     packedvalue_handle value;
     template <typename T>
     operator T() {
-      return ctypes::PackedFunc::Arg(type_code, *reinterpret_cast<PackedValue*>(&value)).operator T();
+      PackedValue v;
+      std::memcpy(&v, &value, sizeof(v));
+      return ctypes::PackedFunc::Arg(type_code, v).operator T();
     }
   };
 
@@ -80,9 +85,275 @@ static int test_func() {
   return 0;
 }
 
+static int test_batch() {
+  auto f = client::Get("PackedFunc", "hello");
+  const size_t num_calls = 4;
+  std::vector<unsigned> type_codes(num_calls * 2, PackedTypeCode::kInt64);
+  std::vector<packedvalue_handle> values(num_calls * 2);
+  for (size_t i = 0; i < num_calls; i++) {
+    values[i * 2].v_int64 = i;
+    values[i * 2 + 1].v_int64 = 10;
+  }
+  std::vector<unsigned> ret_types(num_calls);
+  std::vector<packedvalue_handle> ret_vals(num_calls);
+  CHECK_CTI(CTIPackedFuncCallBatch(f.handle, num_calls, 2, type_codes.data(), values.data(), ret_types.data(), ret_vals.data()));
+  std::cout << "hello batch: [";
+  for (size_t i = 0; i < num_calls; i++) {
+    CHECK_EQ(ret_types[i], PackedTypeCode::kInt64);
+    std::cout << ret_vals[i].v_int64 << ",";
+  }
+  std::cout << "]" << std::endl;
+
+  // every outer call batches append_str, whose results should not replace the outer ones
+  ctypes::PackedFunc nested([](ctypes::PackedFunc::Args args, ctypes::PackedFunc::RetValue* rv) {
+    const int64_t n = args[0];
+    std::vector<unsigned> codes(n * 2, PackedTypeCode::kStr);
+    std::vector<packedvalue_handle> strs(n * 2);
+    for (auto& s : strs) {
+      s.v_str = "x";
+    }
+    std::vector<unsigned> types(n);
+    std::vector<packedvalue_handle> vals(n);
+    auto append_str = client::Get("PackedFunc", "append_str");
+    CHECK_CTI(CTIPackedFuncCallBatch(append_str.handle, n, 2, codes.data(), strs.data(),
+        types.data(), vals.data()));
+    std::string r;
+    for (int64_t i = 0; i < n; i++) {
+      r += vals[i].v_str;
+    }
+    rv->reset(r);
+  });
+  std::vector<std::string> nested_results;
+  std::vector<packedvalue_handle> counts(num_calls);
+  for (auto& c : counts) {
+    c.v_int64 = 10;
+  }
+  CHECK_CTI(CTIPackedFuncCallBatch(&nested, num_calls, 1, type_codes.data(), counts.data(), ret_types.data(), ret_vals.data()));
+  std::transform(ret_vals.begin(), ret_vals.end(), std::back_inserter(nested_results), [](auto v) { return std::string(v.v_str); });
+  CHECK_EQ(nested_results[0].size(), 30u);
+  CHECK_EQ(nested_results[3], nested_results[0]);
+  std::cout << "nested batch: " << nested_results[0].substr(0, 6) << std::endl;
+  return 0;
+}
+
+static int test_owned() {
+  auto f = client::Get("PackedFunc", "append_str");
+  const unsigned type_codes[] = { PackedTypeCode::kStr, PackedTypeCode::kStr };
+  packedvalue_handle values[2];
+  values[0].v_str = "hello";
+  values[1].v_str = "world";
+  retvalue_handle handles[2];
+  unsigned ret_types[2];
+  packedvalue_handle ret_vals[2];
+  CHECK_CTI(CTIPackedFuncCallOwned(f.handle, 2, type_codes, values, &handles[0], &ret_types[0], &ret_vals[0]));
+  values[1].v_str = "again";
+  CHECK_CTI(CTIPackedFuncCallOwned(f.handle, 2, type_codes, values, &handles[1], &ret_types[1], &ret_vals[1]));
+  std::cout << "append_str owned: " << ret_vals[0].v_str << ", " << ret_vals[1].v_str << std::endl;
+  CHECK_CTI(CTIRetValueRelease(handles[0]));
+  // results may be released from another thread
+  std::thread([&]() { CHECK_CTI(CTIRetValueRelease(handles[1])); }).join();
+  return 0;
+}
+
+static int test_async() {
+  auto f = client::Get("PackedFunc", "hello");
+  completionqueue_handle queue;
+  CHECK_CTI(CTICompletionQueueCreate(&queue));
+  const unsigned type_codes[] = { PackedTypeCode::kInt64, PackedTypeCode::kInt64 };
+  packedvalue_handle values[2];
+  const size_t num_calls = 4;
+  for (size_t i = 0; i < num_calls; i++) {
+    uint64_t ticket;
+    values[0].v_int64 = i;
+    values[1].v_int64 = 100;
+    CHECK_CTI(CTIPackedFuncCallAsync(f.handle, 2, type_codes, values, queue, &ticket));
+  }
+  int64_t sum = 0;
+  for (size_t i = 0; i < num_calls; i++) {
+    int ready;
+    uint64_t ticket;
+    retvalue_handle handle;
+    unsigned ret_type;
+    packedvalue_handle ret_val;
+    CHECK_CTI(CTICompletionQueueWait(queue, -1, &ready, &ticket, &handle, &ret_type, &ret_val));
+    CHECK(ready);
+    CHECK_EQ(ret_val.v_int64, static_cast<int64_t>(ticket) + 100);
+    sum += ret_val.v_int64;
+    CHECK_CTI(CTIRetValueRelease(handle));
+  }
+  // drained, waiting forever returns at once
+  int ready;
+  uint64_t ticket;
+  retvalue_handle handle;
+  unsigned ret_type;
+  packedvalue_handle ret_val;
+  CHECK_CTI(CTICompletionQueueWait(queue, -1, &ready, &ticket, &handle, &ret_type, &ret_val));
+  CHECK_EQ(ready, 0);
+  CHECK_CTI(CTICompletionQueueFree(queue));
+  std::cout << "hello async: sum=" << sum << std::endl;
+  return 0;
+}
+
+static int test_arena() {
+  auto f = client::Get("PackedFunc", "append_str");
+  size_t used, reserved, high_water;
+  uint64_t resets, allocations, oversized;
+  CHECK_CTI(CTIArenaGetStats(&used, &reserved, &high_water, &resets, &allocations, &oversized));
+  const uint64_t allocations_before = allocations;
+  // runs nested in test_all, the second result is larger than a chunk
+  std::string a = f("hello", "arena");
+  PackedRagged b = client::Get("PackedFunc", "ragged_range")(400);
+  CHECK_CTI(CTIArenaGetStats(&used, &reserved, &high_water, &resets, &allocations, &oversized));
+  CHECK_EQ(a, "hello arena");
+  CHECK_EQ(b.offsets[b.num_rows], 400 * 399 / 2);
+  CHECK(allocations > allocations_before);
+  CHECK(oversized > 0);
+  // alignments above max_align_t hold after a smaller allocation in the same chunk
+  Arena arena;
+  arena.allocate(1, 1);
+  arena.allocate(1, 1);
+  CHECK_EQ(reinterpret_cast<uintptr_t>(arena.allocate(8, 128)) % 128, 0u);
+  std::cout << "arena: used=" << used << ", reserved=" << reserved << ", allocations=" << allocations << std::endl;
+  return 0;
+}
+
+static int test_object() {
+  auto f = client::Get("PackedFunc", "ext_new");
+  auto get = client::Get("PackedFunc", "ext_get");
+  retvalue_handle handle;
+  unsigned ret_type;
+  packedvalue_handle ret_val;
+  CHECK_CTI(CTIPackedFuncCallOwned(f.handle, 0, nullptr, nullptr, &handle, &ret_type, &ret_val));
+  CHECK(ret_type >= PackedTypeCode::kExtStart);
+  const unsigned type_codes[] = { ret_type };
+  const packedvalue_handle object = ret_val;
+  // keep the object after the result holding it is gone
+  CHECK_CTI(CTIObjectRetain(object.v_voidp));
+  CHECK_CTI(CTIRetValueRelease(handle));
+  CHECK_CTI(CTIPackedFuncCallOwned(get.handle, 1, type_codes, &object, &handle, &ret_type, &ret_val));
+  std::cout << "ext_get retained: " << ret_val.v_str << std::endl;
+  CHECK_CTI(CTIRetValueRelease(handle));
+  CHECK_CTI(CTIObjectRelease(object.v_voidp));
+  return 0;
+}
+
+static int test_types() {
+  size_t size;
+  const unsigned* codes;
+  const char** names;
+  CHECK_CTI(CTITypeList(&size, &codes, &names));
+  std::cout << "types: ";
+  for (size_t i = 0; i < size; i++) {
+    std::cout << names[i] << "=" << codes[i] << ",";
+    const char* name;
+    size_t value_size;
+    unsigned flags;
+    CHECK_EQ(CTITypeGetInfo(codes[i], &name, &value_size, &flags), CTI_SUCCESS);
+    CHECK_EQ(std::string(name), names[i]);
+    if (std::string(name) == "ext::test") {
+      CHECK(flags & CTI_TYPE_REFCOUNTED);
+    }
+  }
+  std::cout << std::endl;
+  const char* name;
+  size_t value_size;
+  unsigned flags;
+  CHECK_EQ(CTITypeGetInfo(PackedTypeCode::kExtStart + 100, &name, &value_size, &flags), CTI_FAILURE);
+  return 0;
+}
+
+static int test_callback() {
+  // the result is kept by the callback until its next call on the thread
+  packedcallback_handle exclaim = [](void*, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
+      unsigned* ret_type, packedvalue_handle* ret_val) -> int {
+    static thread_local std::string result;
+    if (num_args != 2 || type_codes[0] != PackedTypeCode::kStr || type_codes[1] != PackedTypeCode::kStr) {
+      return CTI_FAILURE;
+    }
+    result = std::string(values[0].v_str) + values[1].v_str + "!";
+    *ret_type = PackedTypeCode::kStr;
+    ret_val->v_str = result.c_str();
+    return CTI_SUCCESS;
+  };
+  packedcallback_handle square = [](void* resource, size_t, const unsigned*, const packedvalue_handle* values,
+      unsigned* ret_type, packedvalue_handle* ret_val) -> int {
+    static_cast<std::atomic<int>*>(resource)[0]++;
+    *ret_type = PackedTypeCode::kInt64;
+    ret_val->v_int64 = values[0].v_int64 * values[0].v_int64;
+    return CTI_SUCCESS;
+  };
+  // calls and finalizations of square
+  std::atomic<int> counts[2] = {{0}, {0}};
+  func_handle exclaim_handle, square_handle;
+  CHECK_CTI(CTIPackedFuncCreate(exclaim, nullptr, nullptr, &exclaim_handle));
+  CHECK_CTI(CTIPackedFuncCreate(square, counts, [](void* p) { static_cast<std::atomic<int>*>(p)[1]++; }, &square_handle));
+  std::string appended = client::Get("PackedFunc", "test_append_str")(*static_cast<ctypes::PackedFunc*>(exclaim_handle), "call", "back");
+  std::vector<int64_t> squares = client::Get("PackedFunc", "parallel_map")(
+      PackedManagedVector::create(std::vector<int64_t>{1, 2, 3, 4}), *static_cast<ctypes::PackedFunc*>(square_handle));
+  CHECK_EQ(appended, "callback!");
+  CHECK_EQ(squares.size(), 4u);
+  CHECK_EQ(squares[3], 16);
+  CHECK_EQ(counts[0].load(), 4);
+  CHECK_CTI(CTIPackedFuncFree(exclaim_handle));
+  CHECK_CTI(CTIPackedFuncFree(square_handle));
+  CHECK_EQ(counts[1].load(), 1);
+  std::cout << "callback: " << appended << ", parallel_map: " << squares[0] << "," << squares[3] << std::endl;
+  return 0;
+}
+
+static int test_stats() {
+  funcstats_handle stats;
+  if (CTIRegistryStats("PackedFunc", "append_str", &stats) != CTI_SUCCESS) {
+    std::cout << "stats: disabled" << std::endl;
+    return 0;
+  }
+  CHECK_CTI(CTIRegistryStatsReset("PackedFunc", "append_str"));
+  CHECK_CTI(CTIRegistryStatsEnable(1));
+  auto f = client::Get("PackedFunc", "append_str");
+  for (int i = 0; i < 3; i++) {
+    std::string s = f("ab", "c");
+  }
+  CHECK_CTI(CTIRegistryStatsEnable(0));
+  std::string uncounted = f("ab", "c");
+  CHECK_CTI(CTIRegistryStats("PackedFunc", "append_str", &stats));
+  uint64_t bucketed = 0;
+  for (auto i : stats.histogram) {
+    bucketed += i;
+  }
+  CHECK_EQ(stats.calls, 3u);
+  CHECK_EQ(bucketed, 3u);
+  CHECK_LE(stats.max_ns, stats.total_ns);
+  CHECK_EQ(stats.ret_bytes, 3u * sizeof("ab c"));
+  CHECK_EQ(CTIRegistryStats("PackedFunc", "no_such_func", &stats), CTI_FAILURE);
+  std::cout << "stats: calls " << stats.calls << ", ret_bytes " << stats.ret_bytes << std::endl;
+  return 0;
+}
+
+static int test_trace() {
+  const std::string path = "test_trace.json";
+  if (CTITraceStart(0) != CTI_SUCCESS) {
+    std::cout << "trace: disabled" << std::endl;
+    return 0;
+  }
+  std::string appended = client::Get("PackedFunc", "test_append_str")(*Registry<ctypes::PackedFunc>::Get("append_str"), "trace", "me");
+  CHECK_CTI(CTITraceStop());
+  uint64_t dropped = 0;
+  CHECK_EQ(CTITraceDump(path.c_str(), &dropped), CTI_SUCCESS);
+  std::ifstream f(path);
+  std::string json((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  std::remove(path.c_str());
+  // the nested call is traced too, with the type codes of its arguments
+  CHECK(json.find("\"name\":\"test_append_str\"") != std::string::npos);
+  CHECK(json.find("\"name\":\"append_str\",\"cat\":\"PackedFunc\",\"ph\":\"X\"") != std::string::npos);
+  CHECK(json.find("\"type_codes\":[4,4]") != std::string::npos);
+  CHECK_EQ(dropped, 0u);
+  std::cout << "trace: " << appended << ", " << std::count(json.begin(), json.end(), '\n') - 1 << " lines" << std::endl;
+  return 0;
+}
+
 static int test_all() {
   auto f = client::Get("PackedFunc", "test_all");
-  std::vector<std::function<int()>> ts = { test_packed, test_func };
+  std::vector<std::function<int()>> ts = { test_packed, test_func, test_batch, test_owned, test_async, test_arena, test_object, test_types, test_callback, test_stats, test_trace };
   std::vector<PackedFunc> packed_ts;
   std::transform(ts.begin(), ts.end(), std::back_inserter(packed_ts), [](auto f) -> PackedFunc{
     return PackedFunc{[f](PackedFunc::Args, PackedFunc::RetValue *rv) {
@@ -1,9 +1,22 @@
 #include "api.h"
 #include "packedfunc.h"
+#include "async.h"
+#include "parallel.h"
+#include "mmap.h"
+#include "typeinfo.h"
+#include "callback.h"
 
 using namespace ctypes;
 
 static_assert(sizeof(packedvalue_handle) == sizeof(PackedValue));
+static_assert(sizeof(packeddtype_handle) == sizeof(PackedDType));
+static_assert(sizeof(packedtensor_handle) == sizeof(PackedTensor));
+static_assert(offsetof(packedtensor_handle, strides) == offsetof(PackedTensor, strides));
+static_assert(sizeof(packedragged_handle) == sizeof(PackedRagged));
+static_assert(offsetof(packedragged_handle, type_code) == offsetof(PackedRagged, type_code));
+static_assert(sizeof(packedbytes_handle) == sizeof(PackedBytes));
+static_assert(CTI_TYPE_REFCOUNTED == TypeInfo::kRefcounted);
+static_assert(CTI_STATS_BUCKETS == FuncStats::kBuckets);
 
 int CTIRegistryListNames(const char* tag, OUT size_t* ret_size, OUT const char*** ret_names) {
   static thread_local std::vector<std::string> names;
@@ -20,15 +33,256 @@ int CTIRegistryListNames(const char* tag, OUT size_t* ret_size, OUT const char**
   return CTI_SUCCESS;
 }
 
+int CTIRegistryFreeze(const char* tag) {
+  CHECK_EQ(tag, Registry<PackedFunc>::RegistryName_);
+  Registry<PackedFunc>::Freeze();
+  return CTI_SUCCESS;
+}
+
 int CTIRegistryGet(const char* tag, const char* name, OUT func_handle* ret_handle) {
   CHECK_EQ(tag, Registry<PackedFunc>::RegistryName_);
   *ret_handle = Registry<PackedFunc>::Get(name);
   return CTI_SUCCESS;
 }
 
+int CTIRegistryStatsEnable(int enable) {
+#if CTI_ENABLE_STATS
+  FuncStats::Enable(enable != 0);
+  return CTI_SUCCESS;
+#else
+  return CTI_FAILURE;
+#endif
+}
+
+int CTIRegistryStats(const char* tag, const char* name, OUT funcstats_handle* ret_stats) {
+#if CTI_ENABLE_STATS
+  CHECK_EQ(tag, Registry<PackedFunc>::RegistryName_);
+  const PackedFunc* f = Registry<PackedFunc>::Get(name);
+  if (f == nullptr || f->stats_ == nullptr) {
+    return CTI_FAILURE;
+  }
+  const FuncStats::Snapshot s = f->stats_->snapshot();
+  ret_stats->calls = s.calls;
+  ret_stats->total_ns = s.total_ns;
+  ret_stats->max_ns = s.max_ns;
+  ret_stats->ret_bytes = s.ret_bytes;
+  std::copy(s.histogram.begin(), s.histogram.end(), ret_stats->histogram);
+  return CTI_SUCCESS;
+#else
+  return CTI_FAILURE;
+#endif
+}
+
+int CTIRegistryStatsReset(const char* tag, const char* name) {
+#if CTI_ENABLE_STATS
+  CHECK_EQ(tag, Registry<PackedFunc>::RegistryName_);
+  if (name != nullptr) {
+    const PackedFunc* f = Registry<PackedFunc>::Get(name);
+    if (f == nullptr || f->stats_ == nullptr) {
+      return CTI_FAILURE;
+    }
+    f->stats_->reset();
+    return CTI_SUCCESS;
+  }
+  for (const auto& n : Registry<PackedFunc>::ListNames()) {
+    const PackedFunc* f = Registry<PackedFunc>::Get(n);
+    if (f != nullptr && f->stats_ != nullptr) {
+      f->stats_->reset();
+    }
+  }
+  return CTI_SUCCESS;
+#else
+  return CTI_FAILURE;
+#endif
+}
+
 int CTIPackedFuncCall(const void* handle, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
     OUT unsigned* ret_type, OUT packedvalue_handle* ret_val) {
   PackedFunc::FuncCall(handle, num_args, static_cast<const PackedType*>(type_codes), reinterpret_cast<const PackedValue*>(values),
       static_cast<PackedType*>(ret_type), reinterpret_cast<PackedValue*>(ret_val));
   return CTI_SUCCESS;
 }
+
+int CTIPackedFuncCallOwned(const void* handle, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
+    OUT retvalue_handle* ret_handle, OUT unsigned* ret_type, OUT packedvalue_handle* ret_val) {
+  PackedFunc::FuncCallOwned(handle, num_args, static_cast<const PackedType*>(type_codes), reinterpret_cast<const PackedValue*>(values),
+      ret_handle, static_cast<PackedType*>(ret_type), reinterpret_cast<PackedValue*>(ret_val));
+  return CTI_SUCCESS;
+}
+
+int CTIRetValueRelease(retvalue_handle handle) {
+  PackedFunc::RetValueRelease(handle);
+  return CTI_SUCCESS;
+}
+
+int CTICompletionQueueCreate(OUT completionqueue_handle* ret_queue) {
+  *ret_queue = new CompletionQueue;
+  return CTI_SUCCESS;
+}
+
+int CTICompletionQueueFree(completionqueue_handle queue) {
+  delete static_cast<CompletionQueue*>(queue);
+  return CTI_SUCCESS;
+}
+
+int CTIPackedFuncCallAsync(const void* handle, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
+    completionqueue_handle queue, OUT uint64_t* ret_ticket) {
+  *ret_ticket = static_cast<CompletionQueue*>(queue)->call_async(reinterpret_cast<const PackedFunc*>(handle),
+      num_args, static_cast<const PackedType*>(type_codes), reinterpret_cast<const PackedValue*>(values));
+  return CTI_SUCCESS;
+}
+
+int CTICompletionQueueWait(completionqueue_handle queue, int64_t timeout_ms, OUT int* ret_ready, OUT uint64_t* ret_ticket,
+    OUT retvalue_handle* ret_handle, OUT unsigned* ret_type, OUT packedvalue_handle* ret_val) {
+  CompletionQueue::Completion c{};
+  *ret_ready = static_cast<CompletionQueue*>(queue)->wait(timeout_ms, &c);
+  if (*ret_ready) {
+    *ret_ticket = c.ticket;
+    *ret_handle = c.rv;
+    *ret_type = c.rv->type_code();
+    *reinterpret_cast<PackedValue*>(ret_val) = c.rv->value();
+  }
+  return CTI_SUCCESS;
+}
+
+int CTIParallelGetStats(OUT size_t* ret_num_threads, OUT uint64_t* ret_calls, OUT uint64_t* ret_tasks, OUT uint64_t* ret_steals) {
+  Scheduler::Stats s = Scheduler::Global()->stats();
+  *ret_num_threads = s.num_threads;
+  *ret_calls = s.calls;
+  *ret_tasks = s.tasks;
+  *ret_steals = s.steals;
+  return CTI_SUCCESS;
+}
+
+int CTIStreamNext(stream_handle stream, OUT int* ret_has_next, OUT unsigned* ret_type, OUT packedvalue_handle* ret_val) {
+  PackedStream* s = static_cast<PackedStream*>(stream);
+  *ret_has_next = s->next();
+  *ret_type = s->current().type_code();
+  *reinterpret_cast<PackedValue*>(ret_val) = s->current().value();
+  return CTI_SUCCESS;
+}
+
+int CTIStreamClose(stream_handle stream) {
+  delete static_cast<PackedStream*>(stream);
+  return CTI_SUCCESS;
+}
+
+int CTIPackedFuncCallBatch(const void* handle, size_t num_calls, size_t num_args, const unsigned* type_codes, const packedvalue_handle* values,
+    OUT unsigned* ret_types, OUT packedvalue_handle* ret_vals) {
+  PackedFunc::FuncCallBatch(handle, num_calls, num_args, static_cast<const PackedType*>(type_codes), reinterpret_cast<const PackedValue*>(values),
+      static_cast<PackedType*>(ret_types), reinterpret_cast<PackedValue*>(ret_vals));
+  return CTI_SUCCESS;
+}
+
+int CTIPackedFuncCreate(packedcallback_handle callback, void* resource, packedfinalizer_handle finalizer, OUT func_handle* ret_handle) {
+  *ret_handle = new PackedFunc(PackedCallback::Make(reinterpret_cast<PackedCallback::Callback>(callback), resource, finalizer));
+  return CTI_SUCCESS;
+}
+
+int CTIPackedFuncFree(func_handle handle) {
+  delete static_cast<PackedFunc*>(handle);
+  return CTI_SUCCESS;
+}
+
+int CTIArenaGetStats(OUT size_t* ret_used, OUT size_t* ret_reserved, OUT size_t* ret_high_water,
+    OUT uint64_t* ret_resets, OUT uint64_t* ret_allocations, OUT uint64_t* ret_oversized) {
+  Arena::Stats s = Arena::Local()->stats();
+  *ret_used = s.used;
+  *ret_reserved = s.reserved;
+  *ret_high_water = s.high_water;
+  *ret_resets = s.resets;
+  *ret_allocations = s.allocations;
+  *ret_oversized = s.oversized;
+  return CTI_SUCCESS;
+}
+
+int CTIArenaSetChunkSize(size_t chunk_size) {
+  Arena::SetChunkSize(chunk_size);
+  return CTI_SUCCESS;
+}
+
+int CTITraceStart(size_t events_per_thread) {
+#if CTI_ENABLE_TRACE
+  Trace::Start(events_per_thread);
+  return CTI_SUCCESS;
+#else
+  return CTI_FAILURE;
+#endif
+}
+
+int CTITraceStop() {
+  Trace::Stop();
+  return CTI_SUCCESS;
+}
+
+int CTITraceDump(const char* path, OUT uint64_t* ret_dropped) {
+  if (ret_dropped != nullptr) {
+    *ret_dropped = Trace::Dropped();
+  }
+  return Trace::Dump(path) ? CTI_SUCCESS : CTI_FAILURE;
+}
+
+int CTIMappedFileOpen(const char* path, packeddtype_handle dtype, OUT mappedfile_handle* ret_handle) {
+  *ret_handle = MappedFile::Open(path, PackedDType{dtype.code, dtype.bits, dtype.lanes});
+  return *ret_handle != nullptr ? CTI_SUCCESS : CTI_FAILURE;
+}
+
+int CTIMappedFileRelease(mappedfile_handle handle) {
+  delete static_cast<MappedFile*>(handle);
+  return CTI_SUCCESS;
+}
+
+int CTIObjectRetain(object_handle handle) {
+  static_cast<Object*>(handle)->IncRef();
+  return CTI_SUCCESS;
+}
+
+int CTIObjectRelease(object_handle handle) {
+  static_cast<Object*>(handle)->DecRef();
+  return CTI_SUCCESS;
+}
+
+int CTITypeList(OUT size_t* ret_size, OUT const unsigned** ret_codes, OUT const char*** ret_names) {
+  static thread_local std::vector<unsigned> codes;
+  static thread_local std::vector<const char*> names;
+  codes.clear();
+  names.clear();
+  for (const auto& name : Registry<TypeInfo>::ListNames()) {
+    const TypeInfo* info = Registry<TypeInfo>::Get(name);
+    codes.push_back(info->code);
+    names.push_back(info->name.c_str());
+  }
+  *ret_size = codes.size();
+  *ret_codes = codes.data();
+  *ret_names = names.data();
+  return CTI_SUCCESS;
+}
+
+int CTITypeGetInfo(unsigned type_code, OUT const char** ret_name, OUT size_t* ret_size, OUT unsigned* ret_flags) {
+  const TypeInfo* info = TypeInfo::Get(type_code);
+  if (info == nullptr) {
+    return CTI_FAILURE;
+  }
+  *ret_name = info->name.c_str();
+  *ret_size = info->size;
+  *ret_flags = info->flags;
+  return CTI_SUCCESS;
+}
+
+int CTITypeCopy(unsigned type_code, void* value, OUT void** ret_value) {
+  const TypeInfo* info = TypeInfo::Get(type_code);
+  if (info == nullptr || info->copy == nullptr) {
+    return CTI_FAILURE;
+  }
+  *ret_value = info->copy(value);
+  return CTI_SUCCESS;
+}
+
+int CTITypeFree(unsigned type_code, void* value) {
+  const TypeInfo* info = TypeInfo::Get(type_code);
+  if (info == nullptr || info->free == nullptr) {
+    return CTI_FAILURE;
+  }
+  info->free(value);
+  return CTI_SUCCESS;
+}
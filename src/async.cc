@@ -0,0 +1,103 @@
+#include "async.h"
+
+namespace ctypes {
+
+ThreadPool* ThreadPool::Global() {
+  static ThreadPool inst(std::max(1u, std::thread::hardware_concurrency()));
+  return &inst;
+}
+
+ThreadPool::ThreadPool(size_t num_threads) {
+  workers.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; i++) {
+    workers.emplace_back([this]() { run(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> _lg(mutex);
+    stopped = true;
+  }
+  cv.notify_all();
+  for (auto& t : workers) {
+    t.join();
+  }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> _lg(mutex);
+    tasks.push_back(std::move(task));
+  }
+  cv.notify_one();
+}
+
+void ThreadPool::run() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lk(mutex);
+      cv.wait(lk, [this]() { return stopped || !tasks.empty(); });
+      if (tasks.empty()) {
+        return;
+      }
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+CompletionQueue::~CompletionQueue() {
+  std::unique_lock<std::mutex> lk(mutex);
+  cv.wait(lk, [this]() { return pending == 0; });
+  for (auto& c : done) {
+    PackedFunc::RetValueRelease(c.rv);
+  }
+}
+
+uint64_t CompletionQueue::call_async(const PackedFunc* func, size_t num_args, const PackedType* type_codes, const PackedValue* values) {
+  uint64_t ticket;
+  {
+    std::lock_guard<std::mutex> _lg(mutex);
+    ticket = next_ticket++;
+    pending++;
+  }
+  std::vector<PackedType> type_codes_(type_codes, type_codes + num_args);
+  std::vector<PackedValue> values_(values, values + num_args);
+  ThreadPool::Global()->submit([this, func, ticket, type_codes_ = std::move(type_codes_), values_ = std::move(values_)]() {
+    PackedFunc::Args args(type_codes_.size(), type_codes_.data(), values_.data());
+    PackedFunc::RetValue* rv = Slab<PackedFunc::RetValue>::New();
+    rv->reset(func->call_packed(args));
+    push(Completion{ticket, rv});
+  });
+  return ticket;
+}
+
+void CompletionQueue::push(Completion completion) {
+  // notify under the lock, the destructor may run as soon as pending drops to 0
+  std::lock_guard<std::mutex> _lg(mutex);
+  done.push_back(completion);
+  pending--;
+  cv.notify_all();
+}
+
+bool CompletionQueue::wait(int64_t timeout_ms, Completion* completion) {
+  std::unique_lock<std::mutex> lk(mutex);
+  // with nothing outstanding no completion could ever arrive
+  auto ready = [this]() { return !done.empty() || pending == 0; };
+  if (timeout_ms < 0) {
+    cv.wait(lk, ready);
+  } else if (!cv.wait_for(lk, std::chrono::milliseconds(timeout_ms), ready)) {
+    return false;
+  }
+  if (done.empty()) {
+    return false;
+  }
+  *completion = done.front();
+  done.pop_front();
+  return true;
+}
+
+}
@@ -0,0 +1,97 @@
+#include "callback.h"
+#include "typeinfo.h"
+
+namespace ctypes {
+
+namespace {
+
+struct CallbackResource {
+  void* resource;
+  PackedCallback::Finalizer finalizer;
+
+  CallbackResource(void* resource, PackedCallback::Finalizer finalizer) : resource(resource), finalizer(finalizer) { }
+  CallbackResource(const CallbackResource&) = delete;
+  ~CallbackResource() {
+    if (finalizer != nullptr) {
+      finalizer(resource);
+    }
+  }
+};
+
+PackedManagedTensor CopyTensor(const PackedTensor& t) {
+  PackedManagedTensor r(t.dtype, std::vector<int64_t>(t.shape, t.shape + t.ndim));
+  const size_t bytes = t.dtype.bytes();
+  if (t.contiguous()) {
+    std::memcpy(r.storage.data(), t.data, r.storage.size());
+    return r;
+  }
+  const char* data = static_cast<const char*>(t.data);
+  for (size_t i = 0; i < t.size(); i++) {
+    std::memcpy(r.storage.data() + i * bytes, data + t.offset(i) * bytes, bytes);
+  }
+  return r;
+}
+
+}
+
+PackedFunc PackedCallback::Make(Callback callback, void* resource, Finalizer finalizer) {
+  // copies of the function share the resource
+  auto holder = std::make_shared<CallbackResource>(resource, finalizer);
+  return PackedFunc([callback, holder](PackedFunc::Args args, PackedFunc::RetValue* rv) {
+    PackedType ret_type = PackedTypeCode::kUnknown;
+    PackedValue ret_val{.v_voidp = nullptr};
+    if (callback(holder->resource, args.size(), args.type_codes, args.values, &ret_type, &ret_val) != 0) {
+      FATAL() << "callback failed";
+      rv->switch_to(PackedTypeCode::kUnknown, PackedValue{.v_voidp = nullptr});
+      return;
+    }
+    if (!CopyResult(ret_type, ret_val, rv)) {
+      FATAL() << "callback returned type code " << ret_type << " which could not be copied";
+      rv->switch_to(PackedTypeCode::kUnknown, PackedValue{.v_voidp = nullptr});
+    }
+  });
+}
+
+bool PackedCallback::CopyResult(PackedType type_code, PackedValue value, PackedFunc::RetValue* rv) {
+  switch (type_code) {
+    case PackedTypeCode::kUnknown:
+    case PackedTypeCode::kInt64:
+    case PackedTypeCode::kFloat64:
+    case PackedTypeCode::kPtr:
+      rv->switch_to(type_code, value);
+      return true;
+    case PackedTypeCode::kStr:
+      rv->reset(value.v_str);
+      return true;
+    case PackedTypeCode::kBytes:
+      rv->reset(*reinterpret_cast<const PackedBytes*>(value.v_voidp));
+      return true;
+    case PackedTypeCode::kFunc:
+      rv->reset(*value.v_func);
+      return true;
+    case PackedTypeCode::kTensor:
+      rv->reset(CopyTensor(*reinterpret_cast<const PackedTensor*>(value.v_voidp)));
+      return true;
+    case PackedTypeCode::kVector: {
+      // only elements stored inline, anything else would still point into the host
+      const PackedVector& vec = *value.v_vec;
+      if (vec.size != 0 && vec.type_code != PackedTypeCode::kInt64 && vec.type_code != PackedTypeCode::kFloat64 &&
+          vec.type_code != PackedTypeCode::kPtr) {
+        return false;
+      }
+      rv->reset(PackedManagedVector(vec.type_code, PackedManagedVector::ManagedType(vec.data, vec.data + vec.size)));
+      return true;
+    }
+    default:
+      break;
+  }
+  // ext values are copied, or retained, through the hooks of their type
+  const TypeInfo* info = TypeInfo::Get(type_code);
+  if (info != nullptr && info->copy != nullptr && value.v_voidp != nullptr) {
+    rv->reset(type_code, info->copy(value.v_voidp), info->free);
+    return true;
+  }
+  return false;
+}
+
+}
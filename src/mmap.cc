@@ -0,0 +1,73 @@
+#include "mmap.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CTI_HAS_MMAP 1
+#endif
+
+namespace ctypes {
+
+MappedFile* MappedFile::Open(const std::string& path, PackedDType dtype) {
+#ifdef CTI_HAS_MMAP
+  if (dtype.lanes == 0 || dtype.bytes() == 0) {
+    std::cerr << "could not map " << path << " as " << dtype << std::endl;
+    return nullptr;
+  }
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "could not open " << path << std::endl;
+    return nullptr;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size % dtype.bytes() != 0) {
+    std::cerr << "could not map " << path << " as " << dtype << std::endl;
+    ::close(fd);
+    return nullptr;
+  }
+  std::unique_ptr<MappedFile> r(new MappedFile);
+  r->bytes_ = static_cast<size_t>(st.st_size);
+  // an empty file could not be mapped, it is viewed as an empty tensor
+  if (r->bytes_ != 0) {
+    r->addr_ = ::mmap(nullptr, r->bytes_, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (r->addr_ == MAP_FAILED) {
+    std::cerr << "could not map " << path << std::endl;
+    r->addr_ = nullptr;
+    return nullptr;
+  }
+  r->shape_[0] = static_cast<int64_t>(r->bytes_ / dtype.bytes());
+  r->content = PackedTensor{r->addr_, dtype, 1, r->shape_, nullptr};
+  return r.release();
+#else
+  std::cerr << "mmap is not supported on this platform" << std::endl;
+  return nullptr;
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef CTI_HAS_MMAP
+  if (addr_ != nullptr) {
+    ::munmap(addr_, bytes_);
+  }
+#endif
+}
+
+static auto &packedfunc_mmap_open = Registry<PackedFunc>::Register("mmap_open")
+    .set_typed_body([](std::string path, int64_t code, int64_t bits) -> MappedFile* {
+      if (code < 0 || code > UINT8_MAX || bits <= 0 || bits > UINT8_MAX) {
+        std::cerr << "could not map " << path << " as code " << code << ", bits " << bits << std::endl;
+        return nullptr;
+      }
+      return MappedFile::Open(path, PackedDType{static_cast<uint8_t>(code), static_cast<uint8_t>(bits), 1});
+    });
+
+static auto &packedfunc_mmap_release = Registry<PackedFunc>::Register("mmap_release")
+    .set_typed_body([](MappedFile* file) -> void {
+      delete file;
+    });
+
+}
@@ -0,0 +1,189 @@
+#include "parallel.h"
+
+namespace ctypes {
+
+static thread_local const Scheduler* local_scheduler = nullptr;
+static thread_local size_t local_scheduler_index = 0;
+
+Scheduler* Scheduler::Global() {
+  static Scheduler inst(std::max(1u, std::thread::hardware_concurrency()) - 1);
+  return &inst;
+}
+
+Scheduler::Scheduler(size_t num_workers) {
+  for (size_t i = 0; i < num_workers + 1; i++) {
+    queues.emplace_back(new Queue);
+  }
+  workers.reserve(num_workers);
+  for (size_t i = 0; i < num_workers; i++) {
+    workers.emplace_back([this, i]() { run(i); });
+  }
+}
+
+Scheduler::~Scheduler() {
+  {
+    std::lock_guard<std::mutex> _lg(sleep_mutex);
+    stopped = true;
+  }
+  sleep_cv.notify_all();
+  for (auto& t : workers) {
+    t.join();
+  }
+}
+
+Scheduler::Stats Scheduler::stats() const {
+  return Stats{num_threads(), calls.load(std::memory_order_relaxed), tasks.load(std::memory_order_relaxed),
+      steals.load(std::memory_order_relaxed)};
+}
+
+size_t Scheduler::local_index() const {
+  if (local_scheduler == this) {
+    return local_scheduler_index;
+  }
+  return queues.size() - 1;
+}
+
+void Scheduler::push(size_t index, Task task) {
+  {
+    std::lock_guard<std::mutex> _lg(queues[index]->mutex);
+    queues[index]->tasks.push_back(task);
+  }
+  num_queued.fetch_add(1, std::memory_order_release);
+  std::lock_guard<std::mutex> _lg(sleep_mutex);
+  sleep_cv.notify_one();
+}
+
+bool Scheduler::pop(size_t index, Task* task) {
+  if (num_queued.load(std::memory_order_acquire) == 0) {
+    return false;
+  }
+  {
+    Queue& q = *queues[index];
+    std::lock_guard<std::mutex> _lg(q.mutex);
+    if (!q.tasks.empty()) {
+      *task = q.tasks.back();
+      q.tasks.pop_back();
+      num_queued.fetch_sub(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues.size(); i++) {
+    Queue& q = *queues[(index + i) % queues.size()];
+    std::lock_guard<std::mutex> _lg(q.mutex);
+    if (!q.tasks.empty()) {
+      *task = q.tasks.front();
+      q.tasks.pop_front();
+      num_queued.fetch_sub(1, std::memory_order_relaxed);
+      steals.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void Scheduler::execute(size_t index, Task task) {
+  Job* job = task.job;
+  while (task.end - task.begin > job->grain) {
+    size_t mid = task.begin + (task.end - task.begin) / 2;
+    push(index, Task{job, mid, task.end});
+    task.end = mid;
+  }
+  (*job->body)(task.begin, task.end);
+  tasks.fetch_add(1, std::memory_order_relaxed);
+  const size_t size = task.end - task.begin;
+  // the job lives on its caller's stack and must not be touched once remaining reaches 0
+  if (job->remaining.fetch_sub(size, std::memory_order_acq_rel) == size) {
+    std::lock_guard<std::mutex> _lg(sleep_mutex);
+    sleep_cv.notify_all();
+  }
+}
+
+void Scheduler::run(size_t index) {
+  local_scheduler = this;
+  local_scheduler_index = index;
+  while (true) {
+    Task task;
+    if (pop(index, &task)) {
+      execute(index, task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lk(sleep_mutex);
+    sleep_cv.wait(lk, [this]() { return stopped || num_queued.load(std::memory_order_acquire) > 0; });
+    if (stopped) {
+      return;
+    }
+  }
+}
+
+void Scheduler::parallel_for(size_t n, const Body& body, size_t grain) {
+  if (n == 0) {
+    return;
+  }
+  calls.fetch_add(1, std::memory_order_relaxed);
+  if (grain == 0) {
+    grain = std::max<size_t>(1, n / (num_threads() * 8));
+  }
+  Job job{&body, grain, {n}};
+  const size_t index = local_index();
+  execute(index, Task{&job, 0, n});
+  while (job.remaining.load(std::memory_order_acquire) != 0) {
+    Task task;
+    if (pop(index, &task)) {
+      execute(index, task);
+      continue;
+    }
+    std::unique_lock<std::mutex> lk(sleep_mutex);
+    sleep_cv.wait(lk, [this, &job]() {
+      return job.remaining.load(std::memory_order_acquire) == 0 || num_queued.load(std::memory_order_acquire) > 0;
+    });
+  }
+}
+
+static auto &packedfunc_parallel_for = Registry<PackedFunc>::Register("parallel_for")
+    .set_typed_body([](int64_t n, PackedFunc body) -> int {
+      // a negative count would wrap around to almost 2^64 iterations
+      if (n <= 0) {
+        CHECK(n == 0) << "parallel_for count " << n << " is negative";
+        return 0;
+      }
+      Scheduler::Global()->parallel_for(static_cast<size_t>(n), [&body](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          body(static_cast<int64_t>(i));
+        }
+      });
+      return 0;
+    });
+
+// Results are stored by value, so only numbers and pointers are kept. Any other result type, or results
+// of mixed types, give an empty vector of kUnknown as the RetValues owning them are gone by then.
+static auto &packedfunc_parallel_map = Registry<PackedFunc>::Register("parallel_map")
+    .set_typed_body([](PackedVector vec, PackedFunc f) -> PackedManagedVector {
+      PackedManagedVector::ManagedType values(vec.size);
+      std::vector<PackedType> type_codes(vec.size, PackedTypeCode::kUnknown);
+      Scheduler::Global()->parallel_for(vec.size, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          PackedFunc::RetValue r = f.call_packed(PackedFunc::Args(1, &vec.type_code, &vec.data[i]));
+          const PackedType code = r.type_code();
+          if (code == PackedTypeCode::kInt64 || code == PackedTypeCode::kFloat64 || code == PackedTypeCode::kPtr) {
+            type_codes[i] = code;
+            values[i] = r.value();
+          }
+        }
+      });
+      PackedType type_code = type_codes.empty() ? PackedTypeCode::kUnknown : type_codes[0];
+      bool same = std::all_of(type_codes.begin(), type_codes.end(), [type_code](PackedType i) { return i == type_code; });
+      if (!type_codes.empty() && (type_code == PackedTypeCode::kUnknown || !same)) {
+        FATAL() << "parallel_map could only keep results of one number or pointer type";
+        return PackedManagedVector(PackedTypeCode::kUnknown, {});
+      }
+      return PackedManagedVector(type_code, std::move(values));
+    });
+
+static auto &packedfunc_parallel_stats = Registry<PackedFunc>::Register("parallel_stats")
+    .set_typed_body([]() -> std::vector<int64_t> {
+      Scheduler::Stats s = Scheduler::Global()->stats();
+      return {static_cast<int64_t>(s.num_threads), static_cast<int64_t>(s.calls),
+              static_cast<int64_t>(s.tasks), static_cast<int64_t>(s.steals)};
+    });
+
+}
@@ -0,0 +1,157 @@
+#include "trace.h"
+#include <fstream>
+#include <iomanip>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define CTI_HAS_GETPID 1
+#endif
+
+namespace ctypes {
+
+namespace {
+
+struct Buffer {
+  Buffer(uint64_t session, uint64_t tid, size_t capacity) : session(session), tid(tid), events(capacity) { }
+
+  const uint64_t session;
+  const uint64_t tid;
+  std::vector<Trace::Event> events;
+  // only the owning thread appends, events below size are published
+  std::atomic<size_t> size{0};
+};
+
+struct Session {
+  std::mutex mutex;
+  uint64_t id = 0;
+  uint64_t start_ns = 0;
+  size_t capacity = Trace::kDefaultCapacity;
+  std::vector<std::shared_ptr<Buffer>> buffers;
+  std::atomic<uint64_t> dropped{0};
+  // read without the mutex by Record, which only needs to notice a new session
+  std::atomic<uint64_t> current{0};
+
+  static Session* Global() {
+    static Session inst;
+    return &inst;
+  }
+};
+
+uint64_t ThreadId() {
+  static std::atomic<uint64_t> next{0};
+  static thread_local uint64_t tid = ++next;
+  return tid;
+}
+
+void WriteString(std::ostream& o, const char* s) {
+  o << '"';
+  for (; *s != '\0'; s++) {
+    const unsigned char c = *s;
+    if (c == '"' || c == '\\') {
+      o << '\\' << c;
+    } else if (c < 0x20) {
+      o << "\\u" << std::hex << std::setw(4) << std::setfill('0') << unsigned(c) << std::dec;
+    } else {
+      o << c;
+    }
+  }
+  o << '"';
+}
+
+// trace timestamps are microseconds
+void WriteMicros(std::ostream& o, uint64_t ns) {
+  o << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000;
+}
+
+}
+
+void Trace::Start(size_t capacity) {
+  Session* s = Session::Global();
+  std::lock_guard<std::mutex> _lg(s->mutex);
+  s->capacity = capacity == 0 ? kDefaultCapacity : capacity;
+  s->buffers.clear();
+  s->dropped.store(0, std::memory_order_relaxed);
+  s->start_ns = FuncStats::Now();
+  s->id++;
+  s->current.store(s->id, std::memory_order_release);
+  Flag().store(true, std::memory_order_relaxed);
+}
+
+void Trace::Stop() {
+  Flag().store(false, std::memory_order_relaxed);
+}
+
+uint64_t Trace::Dropped() {
+  return Session::Global()->dropped.load(std::memory_order_relaxed);
+}
+
+void Trace::Record(const Span& span) {
+  static thread_local std::shared_ptr<Buffer> local;
+  Session* s = Session::Global();
+  if (local == nullptr || local->session != s->current.load(std::memory_order_acquire)) {
+    std::lock_guard<std::mutex> _lg(s->mutex);
+    // spans begun before the session started belong to none
+    if (span.begin_ns < s->start_ns) {
+      return;
+    }
+    local = std::make_shared<Buffer>(s->id, ThreadId(), s->capacity);
+    s->buffers.push_back(local);
+  }
+  const size_t i = local->size.load(std::memory_order_relaxed);
+  if (i == local->events.size()) {
+    s->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  Event& e = local->events[i];
+  e.begin_ns = span.begin_ns;
+  e.end_ns = FuncStats::Now();
+  e.name = span.name;
+  e.num_args = span.num_args;
+  std::copy(span.type_codes, span.type_codes + std::min(span.num_args, kMaxArgs), e.type_codes);
+  local->size.store(i + 1, std::memory_order_release);
+}
+
+bool Trace::Dump(const std::string& path) {
+  Session* s = Session::Global();
+  std::vector<std::shared_ptr<Buffer>> buffers;
+  uint64_t start_ns;
+  {
+    std::lock_guard<std::mutex> _lg(s->mutex);
+    buffers = s->buffers;
+    start_ns = s->start_ns;
+  }
+  std::ofstream o(path);
+  if (!o) {
+    std::cerr << "could not write trace to " << path << std::endl;
+    return false;
+  }
+#ifdef CTI_HAS_GETPID
+  const long pid = ::getpid();
+#else
+  const long pid = 0;
+#endif
+  o << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto& b : buffers) {
+    const size_t size = b->size.load(std::memory_order_acquire);
+    for (size_t i = 0; i < size; i++) {
+      const Event& e = b->events[i];
+      o << (first ? "\n" : ",\n") << "{\"name\":";
+      WriteString(o, e.name);
+      o << ",\"cat\":\"PackedFunc\",\"ph\":\"X\",\"ts\":";
+      WriteMicros(o, e.begin_ns - start_ns);
+      o << ",\"dur\":";
+      WriteMicros(o, e.end_ns - e.begin_ns);
+      o << ",\"pid\":" << pid << ",\"tid\":" << b->tid << ",\"args\":{\"num_args\":" << e.num_args << ",\"type_codes\":[";
+      for (size_t j = 0; j < std::min<size_t>(e.num_args, kMaxArgs); j++) {
+        o << (j == 0 ? "" : ",") << e.type_codes[j];
+      }
+      o << "]}}";
+      first = false;
+    }
+  }
+  o << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped\":" << Dropped() << "}}\n";
+  return bool(o);
+}
+
+}
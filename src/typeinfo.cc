@@ -0,0 +1,22 @@
+#include "typeinfo.h"
+#include "mmap.h"
+
+namespace ctypes {
+
+template <> const std::string Registry<TypeInfo>::RegistryName_ = "TypeInfo";
+
+// builtin types, named like PackedTypeCode
+static auto &typeinfo_unknown = Registry<TypeInfo>::Register("kUnknown").set_code(PackedTypeCode::kUnknown);
+static auto &typeinfo_int64 = Registry<TypeInfo>::Register("kInt64").set_code(PackedTypeCode::kInt64);
+static auto &typeinfo_float64 = Registry<TypeInfo>::Register("kFloat64").set_code(PackedTypeCode::kFloat64);
+static auto &typeinfo_ptr = Registry<TypeInfo>::Register("kPtr").set_code(PackedTypeCode::kPtr);
+static auto &typeinfo_str = Registry<TypeInfo>::Register("kStr").set_code(PackedTypeCode::kStr);
+static auto &typeinfo_func = Registry<TypeInfo>::Register("kFunc").set_code(PackedTypeCode::kFunc, sizeof(PackedFunc));
+static auto &typeinfo_vector = Registry<TypeInfo>::Register("kVector").set_code(PackedTypeCode::kVector, sizeof(PackedVector));
+static auto &typeinfo_stream = Registry<TypeInfo>::Register("kStream").set_code(PackedTypeCode::kStream);
+static auto &typeinfo_tensor = Registry<TypeInfo>::Register("kTensor").set_code(PackedTypeCode::kTensor, sizeof(PackedTensor));
+static auto &typeinfo_ragged = Registry<TypeInfo>::Register("kRagged").set_code(PackedTypeCode::kRagged, sizeof(PackedRagged));
+static auto &typeinfo_bytes = Registry<TypeInfo>::Register("kBytes").set_code(PackedTypeCode::kBytes, sizeof(PackedBytes));
+static auto &typeinfo_mapped_file = Registry<TypeInfo>::Register("kMappedFile").set_code(PackedTypeCode::kMappedFile, sizeof(MappedFile));
+
+}